@@ -0,0 +1,347 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Times the image operations and file formats on generated images
+ ******************************************************************************/
+#include "netPBM.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define NETPBM_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define NETPBM_RDTSC
+#endif
+
+/*!
+ * @brief Each case is repeated until it has run at least this long
+ */
+const double BENCH_MIN_SECONDS = 0.25;
+
+/*!
+ * @brief Timing of one benchmark case, the fastest of its repeats
+ */
+struct benchResult
+{
+    double seconds;     /*!< Wall time of the fastest repeat*/
+    double cycles;      /*!< Time stamp counter ticks of that repeat*/
+};
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads the processor's time stamp counter where there is one.
+ *
+ * @returns the counter, or 0 if it can't be read
+ *
+ ******************************************************************************/
+unsigned long long readCycles()
+{
+#ifdef NETPBM_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Fills an image with made up pixels that are always the same for the same
+ * size and seed: smooth gradients, flat patches and some noise, so filters,
+ * contrast and ASCII widths see something like a real photo.
+ *
+ * @param[out] file - image to allocate and fill.
+ * @param[in] rows - height of the image.
+ * @param[in] cols - width of the image.
+ * @param[in] seed - starting value for the noise.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool makeTestImage(image &file, int rows, int cols, unsigned seed)
+{
+    int i, j;
+    unsigned state = seed * 2654435761u + 1;
+    unsigned noise;
+
+    file.header = "P6";
+    file.comment = "# generated";
+    file.rows = file.srcRows = rows;
+    file.cols = file.srcCols = cols;
+    file.max = 255;
+    if (!alloc2d(file.redgray, rows, cols) || !alloc2d(file.green, rows, cols)
+        || !alloc2d(file.blue, rows, cols))
+        return false;
+
+    for (i = 0; i < rows; i++)
+        for (j = 0; j < cols; j++)
+        {
+            state ^= state << 13; //xorshift
+            state ^= state >> 17;
+            state ^= state << 5;
+            noise = state & 31;
+            if ((i / 64 + j / 64) % 3 == 0) //flat patch
+            {
+                file.redgray[i][j] = 200;
+                file.green[i][j] = 200;
+                file.blue[i][j] = 190;
+                continue;
+            }
+            file.redgray[i][j] = (pixel)((j * 223 / max(cols, 1)) + noise);
+            file.green[i][j] = (pixel)((i * 223 / max(rows, 1)) + noise);
+            file.blue[i][j] = (pixel)(((i + j) * 111 / max(rows + cols, 1)) +
+                (noise ^ 17));
+        }
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Copies the pixels of one image into another of the same size.
+ *
+ * @param[in] src - image to copy from.
+ * @param[in,out] dst - image to copy into, allocated to the same size.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void copyPixels(const image &src, image &dst)
+{
+    size_t size = (size_t)src.rows * src.cols;
+    memcpy(dst.redgray[0], src.redgray[0], size);
+    memcpy(dst.green[0], src.green[0], size);
+    memcpy(dst.blue[0], src.blue[0], size);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Times one case. setup runs untimed before every repeat, then work is
+ * timed. Repeats continue until they add up to BENCH_MIN_SECONDS, with at
+ * least three, and the fastest one is kept.
+ *
+ * @param[in] setup - puts things back the way work expects them.
+ * @param[in] work - the thing being timed.
+ *
+ * @returns time and cycles of the fastest repeat
+ *
+ ******************************************************************************/
+benchResult timeCase(const function<void()> &setup,
+    const function<void()> &work)
+{
+    int runs = 0;
+    double total = 0, seconds;
+    unsigned long long cycles;
+    benchResult best = { 1e30, 0 };
+    chrono::steady_clock::time_point start;
+
+    while (runs < 3 || total < BENCH_MIN_SECONDS)
+    {
+        setup();
+        start = chrono::steady_clock::now();
+        cycles = readCycles();
+        work();
+        cycles = readCycles() - cycles;
+        seconds = chrono::duration<double>(chrono::steady_clock::now() -
+            start).count();
+        if (seconds < best.seconds)
+        {
+            best.seconds = seconds;
+            best.cycles = (double)cycles;
+        }
+        total += seconds;
+        runs++;
+    }
+    return best;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes one result as a CSV line and echoes a readable version to the
+ * screen.
+ *
+ * @param[in] out - where the CSV line goes.
+ * @param[in] name - name of the case.
+ * @param[in] file - the image the case ran on.
+ * @param[in] threads - number of threads used.
+ * @param[in] bytes - bytes the case read or wrote.
+ * @param[in] result - the timing of the case.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void reportCase(ostream &out, string name, image &file, int threads,
+    double bytes, benchResult result)
+{
+    double pixels = (double)file.rows * file.cols;
+    char line[256];
+
+    snprintf(line, sizeof(line), "%s,%d,%d,%d,%.6f,%.2f,%.2f,%.3f",
+        name.c_str(), file.cols, file.rows, threads, result.seconds,
+        pixels / result.seconds / 1e6, bytes / result.seconds / 1e6,
+        result.cycles / pixels);
+    out << line << '\n';
+    out.flush();
+
+    snprintf(line, sizeof(line), "%-14s %5dx%-5d %2d threads %9.2f MP/s "
+        "%9.2f MB/s %8.2f cycles/pixel", name.c_str(), file.cols, file.rows,
+        threads, pixels / result.seconds / 1e6, bytes / result.seconds / 1e6,
+        result.cycles / pixels);
+    cout << line << endl;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Runs every image operation and every file format on generated images of
+ * several sizes and with several thread counts. Results are written as CSV
+ * with a header line, one line per case, so runs from two commits can be
+ * compared directly. Cycle counts read 0 where there is no time stamp
+ * counter. The format cases use a scratch file in the current folder.
+ *
+ * @param[in] outname - CSV file to write, or empty to write it to the screen.
+ *
+ * @returns true - all cases ran
+ * @returns false - memory or file error
+ *
+ ******************************************************************************/
+bool runBenchmarks(string outname)
+{
+    const int sizes[][2] = { { 256, 256 }, { 1024, 768 }, { 2048, 2048 } };
+    const string scratch = "bench_scratch";
+    unsigned hardware = thread::hardware_concurrency();
+    vector<int> threadCounts = { 1, 2, 4 };
+    size_t s, t;
+    int k;
+    double size;
+    bool ok = true;
+    image original, work;
+    ifstream fin;
+    ofstream fout, results;
+    ostream *out = &cout;
+    benchResult result;
+
+    if (hardware > 4)
+        threadCounts.push_back((int)hardware);
+    if (outname.size() != 0)
+    {
+        results.open(outname);
+        if (!results)
+        {
+            cout << "File could not open." << endl;
+            return false;
+        }
+        out = &results;
+    }
+    *out << "name,cols,rows,threads,seconds,megapixels_per_s,"
+        << "megabytes_per_s,cycles_per_pixel" << '\n';
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && ok; s++)
+    {
+        if (!makeTestImage(original, sizes[s][1], sizes[s][0], 215) ||
+            !makeTestImage(work, sizes[s][1], sizes[s][0], 215))
+            return false;
+        size = 3.0 * original.rows * original.cols;
+
+        for (t = 0; t < threadCounts.size(); t++)
+        {
+            setThreadCount(threadCounts[t]);
+            auto reset = [&]() { copyPixels(original, work); };
+            auto report = [&](string name, double bytes)
+            {
+                reportCase(*out, name, work, threadCounts[t], bytes, result);
+            };
+
+            result = timeCase(reset, [&]() { ::negate(work); });
+            report("negate", size);
+            result = timeCase(reset, [&]() { brighten(work, 40); });
+            report("brighten", size);
+            result = timeCase(reset, [&]() { grayscale(work); });
+            report("grayscale", size);
+            result = timeCase(reset, [&]() { contrast(work); });
+            report("contrast", size);
+            result = timeCase(reset, [&]() { ok = sharpen(work) && ok; });
+            report("sharpen", size);
+            result = timeCase(reset, [&]() { ok = smooth(work) && ok; });
+            report("smooth", size);
+            result = timeCase(reset, [&]()
+                { ok = adaptiveThreshold(work, 4, false) && ok; });
+            report("adaptive_r4", size);
+            result = timeCase(reset, [&]()
+                { ok = adaptiveThreshold(work, 64, false) && ok; });
+            report("adaptive_r64", size);
+            result = timeCase(reset, [&]()
+                { ok = localContrast(work, 4, false) && ok; });
+            report("local_r4", size);
+            result = timeCase(reset, [&]()
+                { ok = localContrast(work, 64, false) && ok; });
+            report("local_r64", size);
+
+            //formats: write one copy first so the reads have a file
+            for (k = 0; k < 4; k++)
+            {
+                string name = k == 0 ? "p3" : k == 1 ? "p6" : k == 2 ? "pz" :
+                    "pt";
+                string ext = k == 2 ? ".pzc" : k == 3 ? ".ptl" : ".ppm";
+                auto write = [&]()
+                {
+                    if (k == 0)
+                        writeAscii(fout, work, scratch, false);
+                    else if (k == 1)
+                        writeBinary(fout, work, scratch, false);
+                    else if (k == 2)
+                        writeCompressed(fout, work, scratch, false);
+                    else
+                        writeTiled(fout, work, scratch, false);
+                };
+                result = timeCase(reset, write);
+                fin.open(scratch + ext, ios::in | ios::binary);
+                fin.seekg(0, ios::end);
+                size = (double)fin.tellg();
+                fin.close();
+                report(name + "_write", size);
+
+                result = timeCase([&]() { work.name = scratch + ext; },
+                    [&]()
+                {
+                    if (!readHeaderInfo(fin, work))
+                    {
+                        ok = false;
+                        return;
+                    }
+                    if (k == 0)
+                        readAsciiRGB(fin, work);
+                    else if (k == 1)
+                        readBinaryRGB(fin, work);
+                    else if (k == 2)
+                        ok = readCompressed(fin, work) && ok;
+                    else
+                        ok = readTiled(fin, work) && ok;
+                });
+                report(name + "_read", size);
+                size = 3.0 * original.rows * original.cols;
+            }
+        }
+        freeImage(original);
+        freeImage(work);
+    }
+    remove((scratch + ".ppm").c_str());
+    remove((scratch + ".pzc").c_str());
+    remove((scratch + ".ptl").c_str());
+    setThreadCount(0);
+    return ok;
+}
@@ -0,0 +1,386 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Keeps the output of earlier runs so repeated runs can be copied
+ *
+ * Each entry is one file in the cache folder, named by a hash of the input
+ * file's bytes and the options used, with the extension of the output. A
+ * hit is served by copying that file, as a reflink where the file system
+ * can share the blocks. Entries are touched when used, and the least
+ * recently used ones are removed once the folder is over its size limit.
+ ******************************************************************************/
+#include "netPBM.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#include <sys/utime.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#endif
+
+/*!
+ * @brief One file in the cache folder
+ */
+struct cacheEntry
+{
+    string name;        /*!< File name inside the cache folder*/
+    long long bytes;    /*!< Size of the file*/
+    time_t used;        /*!< Last time it was stored or hit*/
+};
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Hashes a block of bytes eight at a time. Not for security, only to tell
+ * inputs apart quickly. Feeding the result of one block in as the seed of
+ * the next hashes them as if they were one.
+ *
+ * @param[in] data - bytes to hash.
+ * @param[in] size - number of bytes.
+ * @param[in] seed - hash so far.
+ *
+ * @returns the new hash
+ *
+ ******************************************************************************/
+unsigned long long hashBytes(const char *data, size_t size,
+    unsigned long long seed)
+{
+    const unsigned long long prime = 0x9E3779B97F4A7C15ull;
+    unsigned long long h = seed ^ (size * prime);
+    unsigned long long word;
+    size_t k;
+
+    for (k = 0; k + 8 <= size; k += 8)
+    {
+        memcpy(&word, data + k, 8);
+        h = (h ^ word) * prime;
+        h ^= h >> 29;
+    }
+    for (; k < size; k++)
+        h = (h ^ (unsigned char)data[k]) * prime;
+    h ^= h >> 32;
+    return h * prime;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Builds the cache key of a command line: a hash of the input file's bytes,
+ * the options in order and the output format. Numbers given to options are
+ * written back out the standard way, so -b 010 and -b 10 share a key. The
+ * output name is left out, it only says where to put the result. Runs that
+ * patch a file with -op depend on what is already on disk and get no key.
+ *
+ * @param[in] argc - the number of arguments.
+ * @param[in] argv - the arguments, without any of main's leading options.
+ *
+ * @returns the key as 16 hex digits, empty if the run can't be cached
+ *
+ ******************************************************************************/
+string cacheKey(int argc, char **argv)
+{
+    int i;
+    string chain = "prog1 cache 1";
+    string arg;
+    vector<char> buffer(1 << 20);
+    unsigned long long hash;
+    ifstream fin;
+    char key[17];
+
+    if (argc < 4)
+        return "";
+    for (i = 1; i < argc - 2; i++)
+    {
+        arg = argv[i];
+        if (arg == "-op")
+            return "";
+        if ((arg == "-b" || arg == "-R" || arg == "-a" || arg == "-l") &&
+            i + 1 < argc - 2)
+        {
+            chain += '\n' + arg + '\n' + to_string(atoi(argv[i + 1]));
+            i++;
+            continue;
+        }
+        chain += '\n' + arg;
+    }
+
+    fin.open(argv[argc - 1], ios::in | ios::binary);
+    if (!fin)
+        return "";
+    hash = hashBytes(chain.data(), chain.size(), 0);
+    while (fin)
+    {
+        fin.read(buffer.data(), buffer.size());
+        hash = hashBytes(buffer.data(), (size_t)fin.gcount(), hash);
+        profileBytes(fin.gcount(), 0);
+    }
+    snprintf(key, sizeof(key), "%016llx", hash);
+    return key;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Copies a file. Where the file system supports it the copy is a reflink
+ * sharing the same blocks, so it costs almost nothing whatever the size.
+ *
+ * @param[in] from - file to copy.
+ * @param[in] to - file to create or replace.
+ *
+ * @returns true - file copied
+ * @returns false - either file could not be opened or the copy failed
+ *
+ ******************************************************************************/
+bool copyFile(const string &from, const string &to)
+{
+    ifstream fin;
+    ofstream fout;
+#ifdef _WIN32
+    if (CopyFileA(from.c_str(), to.c_str(), FALSE))
+        return true;
+#elif defined(FICLONE)
+    int in, out;
+    bool cloned = false;
+    in = open(from.c_str(), O_RDONLY);
+    if (in >= 0)
+    {
+        out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (out >= 0)
+        {
+            cloned = ioctl(out, FICLONE, in) == 0;
+            close(out);
+        }
+        close(in);
+    }
+    if (cloned)
+        return true;
+#endif
+    fin.open(from, ios::in | ios::binary);
+    fout.open(to, ios::out | ios::trunc | ios::binary);
+    if (!fin || !fout)
+        return false;
+    fout << fin.rdbuf();
+    return !fout.fail();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Renames a file over another in one step, so the old file is there until
+ * the new one takes its place and is kept if the rename fails.
+ *
+ * @param[in] from - file to rename.
+ * @param[in] to - file to create or replace.
+ *
+ * @returns true - file renamed
+ * @returns false - the rename failed, both files are left as they were
+ *
+ ******************************************************************************/
+bool replaceFile(const string &from, const string &to)
+{
+#ifdef _WIN32
+    //rename won't replace a file on Windows
+    return MoveFileExA(from.c_str(), to.c_str(),
+        MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the size and last use of a file.
+ *
+ * @param[in] name - file to look at.
+ * @param[out] entry - its size and time, name is left alone.
+ *
+ * @returns true if the file exists
+ *
+ ******************************************************************************/
+bool cacheStat(const string &name, cacheEntry &entry)
+{
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(name.c_str(), &info) != 0)
+        return false;
+#else
+    struct stat info;
+    if (stat(name.c_str(), &info) != 0)
+        return false;
+#endif
+    entry.bytes = (long long)info.st_size;
+    entry.used = info.st_mtime;
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Lists the files in the cache folder.
+ *
+ * @param[in] dir - the cache folder.
+ *
+ * @returns the entries, in no order
+ *
+ ******************************************************************************/
+vector<cacheEntry> cacheList(const string &dir)
+{
+    vector<cacheEntry> entries;
+    cacheEntry entry;
+#ifdef _WIN32
+    struct _finddata_t found;
+    intptr_t handle = _findfirst((dir + "/*").c_str(), &found);
+    if (handle == -1)
+        return entries;
+    do
+    {
+        if (found.attrib & _A_SUBDIR)
+            continue;
+        entry.name = found.name;
+        if (cacheStat(dir + "/" + entry.name, entry))
+            entries.push_back(entry);
+    } while (_findnext(handle, &found) == 0);
+    _findclose(handle);
+#else
+    DIR *folder = opendir(dir.c_str());
+    dirent *item;
+    if (folder == nullptr)
+        return entries;
+    while ((item = readdir(folder)) != nullptr)
+    {
+        entry.name = item->d_name;
+        if (entry.name[0] == '.')
+            continue;
+        if (cacheStat(dir + "/" + entry.name, entry))
+            entries.push_back(entry);
+    }
+    closedir(folder);
+#endif
+    return entries;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Removes the least recently used entries until the cache folder holds no
+ * more than limit bytes.
+ *
+ * @param[in] dir - the cache folder.
+ * @param[in] limit - most bytes to keep.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void cacheEvict(const string &dir, long long limit)
+{
+    vector<cacheEntry> entries = cacheList(dir);
+    long long total = 0;
+    size_t k;
+
+    for (k = 0; k < entries.size(); k++)
+        total += entries[k].bytes;
+    if (total <= limit)
+        return;
+    sort(entries.begin(), entries.end(), [](const cacheEntry &a,
+        const cacheEntry &b) { return a.used < b.used; });
+    for (k = 0; k < entries.size() && total > limit; k++)
+        if (remove((dir + "/" + entries[k].name).c_str()) == 0)
+            total -= entries[k].bytes;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Runs a command line through the cache. If an earlier run with the same
+ * input bytes and options left its output in the cache, that is copied to
+ * the output name and nothing else is done. Otherwise the command line is
+ * run, and if it wrote a single file that file is stored under the key,
+ * then the cache is trimmed to its limit. Entries are written to a
+ * temporary name and renamed, so other runs never see half an entry.
+ *
+ * @param[in] dir - the cache folder, made if it is not there.
+ * @param[in] limit - most bytes the cache may hold.
+ * @param[in] argc - the number of arguments.
+ * @param[in] argv - the arguments, without any of main's leading options.
+ * @param[in] run - runs the command line and lists the files it wrote.
+ *
+ * @returns what run returns, 0 on a hit
+ *
+ ******************************************************************************/
+int cachedRun(string dir, long long limit, int argc, char **argv,
+    const function<int(int, char**, vector<string>&)> &run)
+{
+    const char *types[4] = { ".ppm", ".pgm", ".pzc", ".ptl" };
+    string key, ext, entry, temp;
+    vector<string> outputs;
+    cacheEntry info;
+    int k, code, stage;
+
+    stage = profileBegin("cache lookup");
+    key = cacheKey(argc, argv);
+    for (k = 0; k < 4 && key.size() != 0; k++)
+    {
+        entry = dir + "/" + key + types[k];
+        if (!cacheStat(entry, info))
+            continue;
+        if (!copyFile(entry, argv[argc - 2] + string(types[k])))
+            break;
+#ifdef _WIN32
+        _utime(entry.c_str(), nullptr); //now the most recently used
+#else
+        utime(entry.c_str(), nullptr);
+#endif
+        profileBytes(info.bytes, info.bytes);
+        profileEnd(stage);
+        return 0;
+    }
+    profileEnd(stage);
+
+    code = run(argc, argv, outputs);
+    if (code != 0 || key.size() == 0 || outputs.size() == 0 ||
+        count(outputs.begin(), outputs.end(), outputs[0]) !=
+        (int)outputs.size())
+        return code;
+
+    stage = profileBegin("cache store");
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+    temp = dir + "/" + key + ".tmp" + to_string(_getpid());
+#else
+    mkdir(dir.c_str(), 0777);
+    temp = dir + "/" + key + ".tmp" + to_string(getpid());
+#endif
+    ext = outputs[0].substr(outputs[0].size() - 4);
+    entry = dir + "/" + key + ext;
+    if (!copyFile(outputs[0], temp) || !replaceFile(temp, entry))
+        remove(temp.c_str());
+    cacheEvict(dir, limit);
+    profileEnd(stage);
+    return code;
+}
@@ -0,0 +1,412 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Reads and writes the compressed planar container (.pzc)
+ *
+ * The container starts with a header like a '.ppm' file, magic number PZ:
+ *
+   @verbatim
+   PZ
+   # optional comment
+   cols rows
+   max
+   @endverbatim
+ *
+ * followed by one byte with the number of planes (1 for gray, 3 for color),
+ * then planes*rows+1 offsets of 8 bytes each, little endian, and then the
+ * packed rows, every row of the first plane, then the second and third.
+ * Offset k is where packed row k starts, counted from the first packed
+ * row, and the last offset is where they end. Each row is stored as the
+ * difference of every pixel from the one to its left, so flat areas turn
+ * into runs of 0, and those differences are run length coded: a control
+ * byte c below 128 is followed by c+1 bytes as they are, and one of 128 or
+ * more is followed by a single byte repeated c-125 times. Rows depend on
+ * nothing but their own bytes, so any of them can be unpacked on its own.
+ ******************************************************************************/
+#include "netPBM.h"
+#include <cstring>
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Packs one row of one color: each pixel minus the pixel to its left, run
+ * length coded. The output never needs more than cols + cols/128 + 2 bytes.
+ *
+ * @param[in] row - pixels of the row.
+ * @param[in] cols - number of pixels.
+ * @param[out] out - where the packed bytes go.
+ *
+ * @returns number of packed bytes
+ *
+ ******************************************************************************/
+size_t packRow(const pixel *row, int cols, pixel *out)
+{
+    int j = 0, run, start;
+    size_t used = 0;
+    //difference of pixel k from the one before it
+    auto delta = [&](int k) { return (pixel)(row[k] - (k > 0 ? row[k - 1] :
+        0)); };
+
+    while (j < cols)
+    {
+        for (run = 1; j + run < cols && run < 130 &&
+            delta(j + run) == delta(j); run++)
+            ;
+        if (run >= 3)
+        {
+            out[used++] = (pixel)(run + 125);
+            out[used++] = delta(j);
+            j += run;
+            continue;
+        }
+        //copy bytes as they are up to the next run of three
+        start = j;
+        while (j < cols && j - start < 128 && !(j + 2 < cols &&
+            delta(j) == delta(j + 1) && delta(j) == delta(j + 2)))
+            j++;
+        out[used++] = (pixel)(j - start - 1);
+        for (run = start; run < j; run++)
+            out[used++] = delta(run);
+    }
+    return used;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Unpacks one row packed by packRow. Pixels missing from short or damaged
+ * data are set to 0 before the differences are added back up.
+ *
+ * @param[in] in - packed bytes of the row.
+ * @param[in] size - number of packed bytes.
+ * @param[out] row - pixels of the row.
+ * @param[in] cols - number of pixels.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void unpackRow(const pixel *in, size_t size, pixel *row, int cols)
+{
+    int j = 0, n;
+    size_t k = 0;
+    pixel value;
+
+    while (j < cols && k < size)
+    {
+        if (in[k] < 128)
+        {
+            for (n = in[k++] + 1; n > 0 && j < cols && k < size; n--)
+                row[j++] = in[k++];
+            continue;
+        }
+        n = in[k++] - 125;
+        value = k < size ? in[k++] : 0;
+        for (; n > 0 && j < cols; n--)
+            row[j++] = value;
+    }
+    for (; j < cols; j++)
+        row[j] = 0;
+    for (j = 1; j < cols; j++) //add the differences back up
+        row[j] = (pixel)(row[j] + row[j - 1]);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads the plane count and row offsets at the start of a container body.
+ * Offsets are checked so every row's bytes lie inside what follows them,
+ * up to size bytes in all; rows that don't are unpacked as 0.
+ *
+ * @param[in] data - body of the container, just after the header.
+ * @param[in] size - bytes available at data.
+ * @param[in] rows - rows in each plane.
+ * @param[out] planes - number of planes, 1 or 3.
+ * @param[out] index - planes*rows+1 row offsets.
+ *
+ * @returns bytes taken by the plane count and offsets, 0 if they are bad
+ *
+ ******************************************************************************/
+size_t readContainerIndex(const char *data, size_t size, int rows,
+    int &planes, vector<unsigned long long> &index)
+{
+    size_t k, b, used;
+    planes = size > 0 ? (unsigned char)data[0] : 0;
+    if (planes != 1 && planes != 3)
+        return 0;
+    index.assign((size_t)planes * rows + 1, 0);
+    used = 1 + 8 * index.size();
+    if (used > size)
+        return 0;
+    for (k = 0; k < index.size(); k++)
+        for (b = 0; b < 8; b++)
+            index[k] |= (unsigned long long)(unsigned char)data[1 + 8 * k +
+                b] << (8 * b);
+    return used;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Unpacks every row of a container body on every core. A gray container
+ * fills all three colors with the gray values.
+ *
+ * @param[in] data - body of the container, just after the header.
+ * @param[in] size - bytes available at data.
+ * @param[in] file - contains all information about image, arrays are being
+ *                   accessed in this case.
+ *
+ * @returns true - body read
+ * @returns false - the plane count or offsets are bad
+ *
+ ******************************************************************************/
+bool decodeCompressedBody(const char *data, size_t size, image &file)
+{
+    int planes;
+    size_t start;
+    vector<unsigned long long> index;
+    pixel **colors[3] = { file.redgray, file.green, file.blue };
+
+    start = readContainerIndex(data, size, file.rows, planes, index);
+    if (start == 0)
+        return false;
+    data += start;
+    size -= start;
+
+    parallelRows(0, file.rows, [&](int first, int last)
+    {
+        int i, p;
+        size_t k;
+        for (i = first; i < last; i++)
+            for (p = 0; p < 3; p++)
+            {
+                k = (size_t)(planes == 1 ? 0 : p) * file.rows + i;
+                if (p > 0 && planes == 1)
+                    memcpy(colors[p][i], colors[0][i], file.cols);
+                else if (index[k] <= index[k + 1] && index[k + 1] <= size)
+                    unpackRow((const pixel*)data + index[k], (size_t)(
+                        index[k + 1] - index[k]), colors[p][i], file.cols);
+                else
+                    unpackRow(nullptr, 0, colors[p][i], file.cols);
+            }
+    });
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads the body of a container file into the color arrays. The plain case
+ * reads the whole body and unpacks rows in parallel. If a region was set,
+ * only the packed bytes of the region's rows are read, one run per plane,
+ * and unpacked in parallel. If a thumbnail size was set, rows are unpacked
+ * in order and averaged down as they go.
+ *
+ * @param[in] file - contains all information about image, arrays are being
+ *                   accessed in this case.
+ * @param[in] fin - ifstream for input from image file.
+ *
+ * @returns true - the body was read
+ * @returns false - invalid container, every pixel is 0
+ *
+ ******************************************************************************/
+bool readCompressed(ifstream &fin, image &file)
+{
+    int i, j, p, planes;
+    size_t head, k;
+    unsigned long long low, high;
+    streamoff end;
+    bool valid;
+    downscaler scale;
+    vector<pixel> rgb, line;
+    vector<char> body;
+    vector<unsigned long long> index;
+    pixel **colors[3] = { file.redgray, file.green, file.blue };
+
+    body.resize(1 + 8 * (3 * (size_t)file.rows + 1));
+    fin.read(body.data(), body.size());
+    head = readContainerIndex(body.data(), (size_t)fin.gcount(), file.rows,
+        planes, index);
+    fin.clear(); //a gray index is shorter than what was asked for
+    valid = head != 0;
+    if (!valid)
+    {
+        index.assign(3 * (size_t)file.rows + 1, 0); //every row comes out 0
+        planes = 3;
+        head = body.size();
+    }
+
+    if (file.roiRows > 0) //read only the region's rows of each plane
+    {
+        fin.seekg(0, ios::end);
+        end = max((streamoff)0, (streamoff)fin.tellg() - file.dataStart -
+            (streamoff)head);
+        for (p = 0; p < planes; p++)
+        {
+            k = (size_t)p * file.rows + file.roiY;
+            //keep the run inside the file even if the offsets are bad
+            low = min(index[k], (unsigned long long)end);
+            high = min(max(low, index[k + file.roiRows]),
+                (unsigned long long)end);
+            body.assign((size_t)(high - low), 0);
+            fin.seekg(file.dataStart + (streamoff)(head + low));
+            fin.read(body.data(), body.size());
+            profileBytes(fin.gcount(), 0);
+            parallelRows(0, file.roiRows, [&](int first, int last)
+            {
+                int i;
+                vector<pixel> row(file.srcCols);
+                for (i = first; i < last; i++)
+                {
+                    if (index[k + i] >= low && index[k + i] <=
+                        index[k + i + 1] && index[k + i + 1] <= high)
+                        unpackRow((const pixel*)body.data() + (index[k + i] -
+                            low), (size_t)(index[k + i + 1] - index[k + i]),
+                            row.data(), file.srcCols);
+                    else
+                        unpackRow(nullptr, 0, row.data(), file.srcCols);
+                    memcpy(colors[p][i], row.data() + file.roiX,
+                        file.roiCols);
+                }
+            });
+        }
+        for (i = 0; planes == 1 && i < file.roiRows; i++)
+        {
+            memcpy(file.green[i], file.redgray[i], file.roiCols);
+            memcpy(file.blue[i], file.redgray[i], file.roiCols);
+        }
+        file.rows = file.roiRows;
+        file.cols = file.roiCols;
+        fin.close();
+        return valid;
+    }
+
+    //everything else needs the whole body
+    fin.seekg(0, ios::end);
+    body.resize((size_t)(fin.tellg() - file.dataStart));
+    fin.seekg(file.dataStart);
+    fin.read(body.data(), body.size());
+    body.resize((size_t)fin.gcount());
+    profileBytes(body.size(), 0);
+    fin.close();
+    if (file.thumbRows == 0)
+    {
+        if (decodeCompressedBody(body.data(), body.size(), file))
+            return true;
+        for (p = 0; p < 3; p++)
+            memset(colors[p][0], 0, (size_t)file.rows * file.cols);
+        return false;
+    }
+
+    initDownscaler(scale, file.rows, file.cols, file.thumbRows,
+        file.thumbCols);
+    rgb.resize(3 * (size_t)file.cols);
+    line.resize(file.cols);
+    for (i = 0; i < file.rows; i++)
+    {
+        for (p = 0; p < planes; p++)
+        {
+            k = (size_t)p * file.rows + i;
+            if (index[k] <= index[k + 1] && head + index[k + 1] <= body.size())
+                unpackRow((const pixel*)body.data() + head + index[k],
+                    (size_t)(index[k + 1] - index[k]), line.data(), file.cols);
+            else
+                unpackRow(nullptr, 0, line.data(), file.cols);
+            for (j = 0; j < file.cols; j++)
+                rgb[3 * j + p] = line[j];
+        }
+        for (j = 0; planes == 1 && j < file.cols; j++)
+            rgb[3 * j + 1] = rgb[3 * j + 2] = rgb[3 * j];
+        downscaleRow(scale, file, i, rgb.data());
+    }
+    file.rows = file.thumbRows;
+    file.cols = file.thumbCols;
+    return valid;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes the image as a container to outname.pzc. A grayscaled image is
+ * stored as a single plane.
+ *
+ * @param[in] file - contains all information about image, arrays are being
+ *                   accessed in this case.
+ * @param[in] fout - ofstream for output to image file
+ * @param[in] outname - output file name.
+ * @param[in] gray - bool that indicates whether or not it has been grayscaled
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void writeCompressed(ofstream &fout, image &file, string outname, bool gray)
+{
+    fout.open(outname + ".pzc", ios::out | ios::trunc | ios::binary);
+    writeCompressedStream(fout, file, gray);
+    profileBytes(0, fout.tellp());
+    fout.close();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes the image as a container to any stream. Rows are packed on every
+ * core into their own slots, then the offsets and rows are written in
+ * order.
+ *
+ * @param[in] fout - stream to write to, opened in binary.
+ * @param[in] file - contains all information about image, arrays are being
+ *                   accessed in this case.
+ * @param[in] gray - bool that indicates whether or not it has been grayscaled
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void writeCompressedStream(ostream &fout, image &file, bool gray)
+{
+    int planes = gray ? 1 : 3;
+    size_t rows = (size_t)planes * file.rows;
+    size_t bound = (size_t)file.cols + file.cols / 128 + 2;
+    size_t k, b;
+    unsigned long long offset = 0;
+    vector<pixel> packed(rows * bound);
+    vector<size_t> sizes(rows);
+    char bytes[8];
+    pixel **colors[3] = { file.redgray, file.green, file.blue };
+
+    parallelRows(0, file.rows, [&](int first, int last)
+    {
+        int i, p;
+        size_t row;
+        for (i = first; i < last; i++)
+            for (p = 0; p < planes; p++)
+            {
+                row = (size_t)p * file.rows + i;
+                sizes[row] = packRow(colors[p][i], file.cols,
+                    &packed[row * bound]);
+            }
+    });
+
+    fout << "PZ" << endl;
+    if (file.comment.size() != 0)
+        fout << file.comment << endl;
+    fout << file.cols << ' ' << file.rows << endl
+        << file.max << endl;
+    fout.put((char)planes);
+    for (k = 0; k <= rows; k++)
+    {
+        for (b = 0; b < 8; b++)
+            bytes[b] = (char)(offset >> (8 * b));
+        fout.write(bytes, 8);
+        if (k < rows)
+            offset += sizes[k];
+    }
+    for (k = 0; k < rows; k++)
+        fout.write((const char*)&packed[k * bound], sizes[k]);
+}
@@ -0,0 +1,142 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Functions that find the edges in the image
+ ******************************************************************************/
+#include "netPBM.h"
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Finds the Sobel gradient magnitude of one row of a gray image. The
+ * magnitude is the sum of the absolute horizontal and vertical gradients,
+ * capped at 255. With SSE2 eight pixels are done at a time in 16 bit math.
+ * The first and last pixel of the row are set to 0 like the other filters.
+ *
+ * @param[in] above - gray row above the one being processed.
+ * @param[in] middle - gray row being processed.
+ * @param[in] below - gray row below the one being processed.
+ * @param[out] out - gradient magnitude of the row.
+ * @param[in] cols - number of pixels in each row.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void sobelRow(const pixel *above, const pixel *middle, const pixel *below,
+    pixel *out, int cols)
+{
+    int j = 1;
+    int gx, gy;
+
+    out[0] = 0;
+    out[cols - 1] = 0;
+#ifdef NETPBM_SSE2
+    __m128i zero = _mm_setzero_si128();
+    __m128i a0, a1, a2, m0, m2, b0, b1, b2, x, y;
+    for (; j + 8 < cols; j += 8)
+    {
+        a0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(above + j - 1)),
+            zero);
+        a1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(above + j)),
+            zero);
+        a2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(above + j + 1)),
+            zero);
+        m0 = _mm_unpacklo_epi8(_mm_loadl_epi64(
+            (const __m128i*)(middle + j - 1)), zero);
+        m2 = _mm_unpacklo_epi8(_mm_loadl_epi64(
+            (const __m128i*)(middle + j + 1)), zero);
+        b0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(below + j - 1)),
+            zero);
+        b1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(below + j)),
+            zero);
+        b2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(below + j + 1)),
+            zero);
+
+        //gx = right column - left column, middle row counted twice
+        x = _mm_sub_epi16(_mm_add_epi16(a2, b2), _mm_add_epi16(a0, b0));
+        x = _mm_add_epi16(x, _mm_slli_epi16(_mm_sub_epi16(m2, m0), 1));
+        //gy = bottom row - top row, middle column counted twice
+        y = _mm_sub_epi16(_mm_add_epi16(b0, b2), _mm_add_epi16(a0, a2));
+        y = _mm_add_epi16(y, _mm_slli_epi16(_mm_sub_epi16(b1, a1), 1));
+
+        x = _mm_max_epi16(x, _mm_sub_epi16(zero, x));
+        y = _mm_max_epi16(y, _mm_sub_epi16(zero, y));
+        x = _mm_packus_epi16(_mm_add_epi16(x, y), zero);
+        _mm_storel_epi64((__m128i*)(out + j), x);
+    }
+#endif
+    for (; j < cols - 1; j++)
+    {
+        gx = above[j + 1] + 2 * middle[j + 1] + below[j + 1] -
+            above[j - 1] - 2 * middle[j - 1] - below[j - 1];
+        gy = below[j - 1] + 2 * below[j] + below[j + 1] -
+            above[j - 1] - 2 * above[j] - above[j + 1];
+        gx = abs(gx) + abs(gy);
+        out[j] = (pixel)(gx > 255 ? 255 : gx);
+    }
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Replaces the image with its edges, found with the 3x3 Sobel operator on
+ * the grayscaled image. If the image is not gray yet, each thread grays the
+ * three rows around the one it is on as it goes, keeping them in a small
+ * rolling buffer. That gives the same result as grayscale followed by this,
+ * in a single pass over the color arrays. Border pixels are set to 0.
+ *
+ * @param[in,out] file - contains all information about image, arrays are
+ *                       being accessed in this case.
+ * @param[in] gray - true if redgray already holds the grayscaled image.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool sobel(image &file, bool gray)
+{
+    if (!alloc2d(file.newred, file.rows, file.cols))
+        return false;
+
+    parallelRows(0, file.rows, [&](int first, int last)
+    {
+        int i, j, r;
+        int done = first - 2; //last row grayed into the rolling buffer
+        vector<pixel> rows(gray ? 0 : 3 * (size_t)file.cols);
+        const pixel *line[3];
+
+        for (i = first; i < last; i++)
+        {
+            if (i == 0 || i == file.rows - 1 || file.cols < 3)
+            {
+                for (j = 0; j < file.cols; j++)
+                    file.newred[i][j] = 0;
+                continue;
+            }
+            for (r = -1; r <= 1; r++)
+            {
+                if (gray)
+                {
+                    line[r + 1] = file.redgray[i + r];
+                    continue;
+                }
+                line[r + 1] = &rows[(size_t)((i + r) % 3) * file.cols];
+                if (i + r <= done)
+                    continue;
+                for (j = 0; j < file.cols; j++)
+                    rows[(size_t)((i + r) % 3) * file.cols + j] = luma(
+                        file.redgray[i + r][j], file.green[i + r][j],
+                        file.blue[i + r][j]);
+                done = i + r;
+            }
+            sobelRow(line[0], line[1], line[2], file.newred[i], file.cols);
+        }
+    });
+
+    free2d(file.redgray, file.rows);
+    file.redgray = file.newred;
+    file.newred = nullptr;
+    return true;
+}
@@ -0,0 +1,290 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Integral images and the operations that use their rectangle sums
+ *
+ * An integral image holds, for every pixel, the sum of all values above and
+ * to the left of it. The sum of any rectangle then takes four lookups, so
+ * operations that look at a window around every pixel cost the same whatever
+ * the window size.
+ ******************************************************************************/
+#include "netPBM.h"
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Builds the integral image of a plane, and of its squared values if asked.
+ * The tables have one more row and column than the plane, the first of each
+ * all 0, so entry (i, j) is the sum of the rows above i and columns left of
+ * j. The sums are 64 bit, so no image size can overflow them. Each row is
+ * first summed left to right, a band of rows per thread, then the rows are
+ * added down each column, a band of columns per thread.
+ *
+ * @param[in] plane - the values to sum.
+ * @param[in] rows - rows in the plane.
+ * @param[in] cols - columns in the plane.
+ * @param[out] table - the sums, resized to fit.
+ * @param[in] squares - also sum the squared values.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void buildIntegral(pixel **plane, int rows, int cols, integralImage &table,
+    bool squares)
+{
+    size_t stride = (size_t)cols + 1;
+
+    table.rows = rows;
+    table.cols = cols;
+    table.sums.assign(((size_t)rows + 1) * stride, 0);
+    table.squares.assign(squares ? ((size_t)rows + 1) * stride : 0, 0);
+
+    parallelRows(0, rows, [&](int first, int last)
+    {
+        int i, j;
+        unsigned long long sum, square;
+        unsigned long long *sumRow, *squareRow;
+
+        for (i = first; i < last; i++)
+        {
+            sumRow = &table.sums[(i + 1) * stride];
+            sum = 0;
+            for (j = 0; j < cols; j++)
+            {
+                sum += plane[i][j];
+                sumRow[j + 1] = sum;
+            }
+            if (!squares)
+                continue;
+            squareRow = &table.squares[(i + 1) * stride];
+            square = 0;
+            for (j = 0; j < cols; j++)
+            {
+                square += (unsigned)plane[i][j] * plane[i][j];
+                squareRow[j + 1] = square;
+            }
+        }
+    });
+
+    //wide bands of columns, so threads seldom share a cache line
+    parallelRows(1, (int)stride, [&](int first, int last)
+    {
+        int i, j;
+        unsigned long long *above, *below;
+
+        for (i = 1; i < rows; i++)
+        {
+            above = &table.sums[i * stride];
+            below = &table.sums[(i + 1) * stride];
+            for (j = first; j < last; j++)
+                below[j] += above[j];
+            if (!squares)
+                continue;
+            above = &table.squares[i * stride];
+            below = &table.squares[(i + 1) * stride];
+            for (j = first; j < last; j++)
+                below[j] += above[j];
+        }
+    }, 64);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the sum of a rectangle from one of the tables of an integral image.
+ *
+ * @param[in] sums - the sums or squares table.
+ * @param[in] cols - columns in the plane the table was built from.
+ * @param[in] top - first row of the rectangle.
+ * @param[in] left - first column of the rectangle.
+ * @param[in] bottom - one past the last row of the rectangle.
+ * @param[in] right - one past the last column of the rectangle.
+ *
+ * @returns the sum of the values in the rectangle
+ *
+ ******************************************************************************/
+unsigned long long integralSum(const vector<unsigned long long> &sums,
+    int cols, int top, int left, int bottom, int right)
+{
+    size_t stride = (size_t)cols + 1;
+    return sums[bottom * stride + right] - sums[top * stride + right] -
+        sums[bottom * stride + left] + sums[top * stride + left];
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Thresholds one pixel against the mean of the window around it, the way
+ * Bradley's method does. The pixel is black if it is at least
+ * ADAPTIVE_PERCENT percent darker than the mean, otherwise white.
+ *
+ * @param[in] value - the gray pixel.
+ * @param[in] sum - sum of the window around it.
+ * @param[in] area - pixels in the window.
+ *
+ * @returns 0 or 255
+ *
+ ******************************************************************************/
+pixel adaptiveValue(pixel value, unsigned long long sum,
+    unsigned long long area)
+{
+    if (value * area * 100 <= sum * (100 - ADAPTIVE_PERCENT))
+        return 0;
+    return 255;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Normalizes one pixel by the mean and standard deviation of the window
+ * around it. The result is centered on 128, with one standard deviation
+ * LOCAL_GAIN values away. Flat windows use LOCAL_MIN_DEVIATION instead, so
+ * noise in them is not blown up.
+ *
+ * @param[in] value - the pixel.
+ * @param[in] sum - sum of the window around it.
+ * @param[in] squares - sum of the squared values of the window.
+ * @param[in] area - pixels in the window.
+ *
+ * @returns the normalized value, capped to 0 through 255
+ *
+ ******************************************************************************/
+pixel localContrastValue(pixel value, unsigned long long sum,
+    unsigned long long squares, unsigned long long area)
+{
+    double mean = (double)sum / area;
+    double variance = (double)squares / area - mean * mean;
+    double deviation = variance > 0 ? sqrt(variance) : 0;
+    double result;
+
+    if (deviation < LOCAL_MIN_DEVIATION)
+        deviation = LOCAL_MIN_DEVIATION;
+    result = 128 + LOCAL_GAIN * (value - mean) / deviation + .5;
+    if (result < 0)
+        return 0;
+    if (result > 255)
+        return 255;
+    return (pixel)result;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Turns the image black and white, comparing each pixel to the mean of the
+ * square window of the given radius around it. The window is cut off at
+ * the edges of the image. Unlike a single threshold this copes with uneven
+ * lighting, such as in a photo of a page. The image is grayscaled first if
+ * it is not gray yet.
+ *
+ * @param[in,out] file - contains all information about image, arrays are
+ *                       being accessed in this case.
+ * @param[in] radius - pixels the window reaches out from the center.
+ * @param[in] gray - true if redgray already holds the grayscaled image.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool adaptiveThreshold(image &file, int radius, bool gray)
+{
+    integralImage table;
+
+    if (!alloc2d(file.newred, file.rows, file.cols))
+        return false;
+    if (!gray)
+        grayscale(file);
+    buildIntegral(file.redgray, file.rows, file.cols, table, false);
+
+    parallelRows(0, file.rows, [&](int first, int last)
+    {
+        int i, j, top, bottom, left, right;
+
+        for (i = first; i < last; i++)
+        {
+            top = max(0, i - radius);
+            bottom = min(file.rows, i + radius + 1);
+            for (j = 0; j < file.cols; j++)
+            {
+                left = max(0, j - radius);
+                right = min(file.cols, j + radius + 1);
+                file.newred[i][j] = adaptiveValue(file.redgray[i][j],
+                    integralSum(table.sums, file.cols, top, left, bottom,
+                    right), (unsigned long long)(bottom - top) *
+                    (right - left));
+            }
+        }
+    });
+
+    free2d(file.redgray, file.rows);
+    file.redgray = file.newred;
+    file.newred = nullptr;
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Evens out the contrast of the image, normalizing each pixel by the mean
+ * and standard deviation of the square window of the given radius around
+ * it. Each color is done on its own. The window is cut off at the edges of
+ * the image.
+ *
+ * @param[in,out] file - contains all information about image, arrays are
+ *                       being accessed in this case.
+ * @param[in] radius - pixels the window reaches out from the center.
+ * @param[in] gray - true if only redgray holds the image.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool localContrast(image &file, int radius, bool gray)
+{
+    pixel ***planes[3] = { &file.redgray, &file.green, &file.blue };
+    pixel ***results[3] = { &file.newred, &file.newgreen, &file.newblue };
+    integralImage table;
+    int k;
+
+    for (k = 0; k < (gray ? 1 : 3); k++)
+    {
+        pixel **plane = *planes[k];
+        pixel **out;
+
+        if (!alloc2d(*results[k], file.rows, file.cols))
+            return false;
+        out = *results[k];
+        buildIntegral(plane, file.rows, file.cols, table, true);
+
+        parallelRows(0, file.rows, [&](int first, int last)
+        {
+            int i, j, top, bottom, left, right;
+
+            for (i = first; i < last; i++)
+            {
+                top = max(0, i - radius);
+                bottom = min(file.rows, i + radius + 1);
+                for (j = 0; j < file.cols; j++)
+                {
+                    left = max(0, j - radius);
+                    right = min(file.cols, j + radius + 1);
+                    out[i][j] = localContrastValue(plane[i][j],
+                        integralSum(table.sums, file.cols, top, left,
+                        bottom, right), integralSum(table.squares,
+                        file.cols, top, left, bottom, right),
+                        (unsigned long long)(bottom - top) * (right - left));
+                }
+            }
+        });
+
+        free2d(*planes[k], file.rows);
+        *planes[k] = out;
+        *results[k] = nullptr;
+    }
+    return true;
+}
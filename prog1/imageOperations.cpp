@@ -47,11 +47,30 @@ void grayscale(image &file)
     for (i = 0; i < file.rows; i++)
         for (j = 0; j < file.cols; j++)
         {
-            file.redgray[i][j] = (pixel)(.3 * (int)file.redgray[i][j] +
-                .6 * (int)file.green[i][j] + .1 * (int)file.blue[i][j]);
+            file.redgray[i][j] = luma(file.redgray[i][j], file.green[i][j],
+                file.blue[i][j]);
         }
 }
 
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the gray value of one pixel. Every operation that grays pixels uses
+ * this so they all give exactly the same value.
+ *
+ * @param[in] r - red value.
+ * @param[in] g - green value.
+ * @param[in] b - blue value.
+ *
+ * @returns the gray value
+ *
+ ******************************************************************************/
+pixel luma(pixel r, pixel g, pixel b)
+{
+    return (pixel)(.3 * (int)r + .6 * (int)g + .1 * (int)b);
+}
+
 /***************************************************************************//**
  * @author Dillon Roller
  *
@@ -175,7 +194,6 @@ void contrast(image &file)
 bool sharpen(image &file)
 {
     int i, j;
-    int r, g, b;
 
     if (!alloc2d(file.newred, file.rows, file.cols) ||
         !alloc2d(file.newgreen, file.rows, file.cols) ||
@@ -193,53 +211,52 @@ bool sharpen(image &file)
             file.newblue[i][j] = (pixel)0;
         }
     }
-    //sharpen new array based on values in oldarray
-    for (i = 1; i < file.rows - 1; i++) 
-    {
-        for (j = 1; j < file.cols - 1; j++)
-        {
-            
-            r = 5 * file.redgray[i][j] - file.redgray[i][j - 1] -
-                file.redgray[i + 1][j] - file.redgray[i][j + 1] -
-                file.redgray[i - 1][j];
-
-            g = 5 * file.green[i][j] - file.green[i][j - 1] -
-                file.green[i + 1][j] - file.green[i][j + 1] -
-                file.green[i - 1][j];
-
-            b = 5 * file.blue[i][j] - file.blue[i][j - 1] -
-                file.blue[i + 1][j] - file.blue[i][j + 1] -
-                file.blue[i - 1][j];
-
-            if (r > 255)
-                r = 255;
-            else if (r < 0)
-                r = 0;
-            file.newred[i][j] = (pixel)r;
-
-            if (g > 255)
-                g = 255;
-            else if (g < 0)
-                g = 0;
-            file.newgreen[i][j] = (pixel)g;
-
-            if (b > 255)
-                b = 255;
-            else if (b < 0)
-                b = 0;
-            file.newblue[i][j] = (pixel)b;
-        }
-    }
-    //copy back to old array and freeup newarray
-    for (i = 0; i < file.rows; i++) 
+    //sharpen new array based on values in oldarray, a band per thread
+    parallelRows(1, file.rows - 1, [&](int first, int last)
     {
-        for (j = 0; j < file.cols; j++)
+        int i, j;
+        int r, g, b;
+        for (i = first; i < last; i++) 
         {
-            file.redgray[i][j] = file.newred[i][j];
-            file.green[i][j] = file.newgreen[i][j];
-            file.blue[i][j] = file.newblue[i][j];
+            for (j = 1; j < file.cols - 1; j++)
+            {
+                
+                r = 5 * file.redgray[i][j] - file.redgray[i][j - 1] -
+                    file.redgray[i + 1][j] - file.redgray[i][j + 1] -
+                    file.redgray[i - 1][j];
+
+                g = 5 * file.green[i][j] - file.green[i][j - 1] -
+                    file.green[i + 1][j] - file.green[i][j + 1] -
+                    file.green[i - 1][j];
+
+                b = 5 * file.blue[i][j] - file.blue[i][j - 1] -
+                    file.blue[i + 1][j] - file.blue[i][j + 1] -
+                    file.blue[i - 1][j];
+
+                if (r > 255)
+                    r = 255;
+                else if (r < 0)
+                    r = 0;
+                file.newred[i][j] = (pixel)r;
+
+                if (g > 255)
+                    g = 255;
+                else if (g < 0)
+                    g = 0;
+                file.newgreen[i][j] = (pixel)g;
+
+                if (b > 255)
+                    b = 255;
+                else if (b < 0)
+                    b = 0;
+                file.newblue[i][j] = (pixel)b;
+            }
         }
-    }
+    });
+    //new arrays become the image, old ones go back to the pool
+    swap(file.redgray, file.newred);
+    swap(file.green, file.newgreen);
+    swap(file.blue, file.newblue);
     free2d(file.newred, file.rows);
     free2d(file.newgreen, file.rows);
     free2d(file.newblue, file.rows);
@@ -262,7 +279,6 @@ bool sharpen(image &file)
 bool smooth(image &file)
 {
     int i, j;
-    double r, g, b;
     if (!alloc2d(file.newred, file.rows, file.cols) ||
         !alloc2d(file.newgreen, file.rows, file.cols) ||
         !alloc2d(file.newblue, file.rows, file.cols)) 
@@ -278,50 +294,270 @@ bool smooth(image &file)
             file.newgreen[i][j] = (pixel)0;
         }
 
-    for (i = 1; i < file.rows - 1; i++)
-        for (j = 1; j < file.cols - 1; j++)
-        {
-            r = ((double)file.redgray[i - 1][j - 1] + file.redgray[i - 1][j] +
-                file.redgray[i - 1][j + 1] + file.redgray[i][j + 1] +
-                file.redgray[i + 1][j + 1] + file.redgray[i + 1][j] +
-                file.redgray[i + 1][j - 1] + file.redgray[i][j - 1]) / 9.0;
-
-            g = ((double)file.green[i - 1][j - 1] + file.green[i - 1][j] +
-                file.green[i - 1][j + 1] + file.green[i][j + 1] +
-                file.green[i + 1][j + 1] + file.green[i + 1][j] +
-                file.green[i + 1][j - 1] + file.green[i][j - 1]) / 9.0;
-
-            b = ((double)file.blue[i - 1][j - 1] + file.blue[i - 1][j] +
-                file.blue[i - 1][j + 1] + file.blue[i][j + 1] +
-                file.blue[i + 1][j + 1] + file.blue[i + 1][j] +
-                file.blue[i + 1][j - 1] + file.blue[i][j - 1]) / 9.0;
-            //int cast to round
-            r += 0.5;
-            g += 0.5;
-            b += 0.5;
-            r = (int)r;
-            g = (int)g;
-            b = (int)b;
-
-            file.newred[i][j] = (pixel)r;
-            file.newgreen[i][j] = (pixel)g;
-            file.newblue[i][j] = (pixel)b;
-        }
+    parallelRows(1, file.rows - 1, [&](int first, int last)
+    {
+        int i, j;
+        double r, g, b;
+        for (i = first; i < last; i++)
+            for (j = 1; j < file.cols - 1; j++)
+            {
+                r = ((double)file.redgray[i - 1][j - 1] +
+                    file.redgray[i - 1][j] + file.redgray[i - 1][j + 1] +
+                    file.redgray[i][j + 1] + file.redgray[i + 1][j + 1] +
+                    file.redgray[i + 1][j] + file.redgray[i + 1][j - 1] +
+                    file.redgray[i][j - 1]) / 9.0;
+
+                g = ((double)file.green[i - 1][j - 1] + file.green[i - 1][j] +
+                    file.green[i - 1][j + 1] + file.green[i][j + 1] +
+                    file.green[i + 1][j + 1] + file.green[i + 1][j] +
+                    file.green[i + 1][j - 1] + file.green[i][j - 1]) / 9.0;
+
+                b = ((double)file.blue[i - 1][j - 1] + file.blue[i - 1][j] +
+                    file.blue[i - 1][j + 1] + file.blue[i][j + 1] +
+                    file.blue[i + 1][j + 1] + file.blue[i + 1][j] +
+                    file.blue[i + 1][j - 1] + file.blue[i][j - 1]) / 9.0;
+                //int cast to round
+                r += 0.5;
+                g += 0.5;
+                b += 0.5;
+                r = (int)r;
+                g = (int)g;
+                b = (int)b;
+
+                file.newred[i][j] = (pixel)r;
+                file.newgreen[i][j] = (pixel)g;
+                file.newblue[i][j] = (pixel)b;
+            }
+    });
+    //new arrays become the image, old ones go back to the pool
+    swap(file.redgray, file.newred);
+    swap(file.green, file.newgreen);
+    swap(file.blue, file.newblue);
+    free2d(file.newred, file.rows);
+    free2d(file.newgreen, file.rows);
+    free2d(file.newblue, file.rows);
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a thumbnail size written as WxH (for example 64x48) from the command
+ * line.
+ *
+ * @param[in] arg - the size argument from the command line.
+ * @param[out] cols - width of the thumbnail.
+ * @param[out] rows - height of the thumbnail.
+ *
+ * @returns true - size was valid
+ * @returns false - size was missing a number or was not positive
+ *
+ ******************************************************************************/
+bool getThumbSize(string arg, int &cols, int &rows)
+{
+    size_t pos, k;
+    pos = arg.find('x');
+    if (pos == string::npos || pos == 0 || pos + 1 == arg.size() ||
+        pos > 9 || arg.size() - pos - 1 > 9)
+        return false;
+
+    for (k = 0; k < arg.size(); k++)
+        if (k != pos && (arg[k] < '0' || arg[k] > '9'))
+            return false;
+
+    cols = stoi(arg.substr(0, pos));
+    rows = stoi(arg.substr(pos + 1));
+    return cols > 0 && rows > 0;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Sets up the running sums used to shrink an image. Each source column is
+ * mapped to the scaled column that covers it, so every scaled pixel ends up
+ * as the average of the block of source pixels under it.
+ *
+ * @param[out] scale - the downscaler to set up.
+ * @param[in] srcRows - rows in the source image.
+ * @param[in] srcCols - columns in the source image.
+ * @param[in] rows - rows in the scaled image, no more than srcRows.
+ * @param[in] cols - columns in the scaled image, no more than srcCols.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void initDownscaler(downscaler &scale, int srcRows, int srcCols, int rows,
+    int cols)
+{
+    int j;
+    scale.srcRows = srcRows;
+    scale.srcCols = srcCols;
+    scale.rows = rows;
+    scale.cols = cols;
+    scale.binRows = 0;
+    scale.colBin.assign(srcCols, 0);
+    scale.binCols.assign(cols, 0);
+    scale.sums.assign(3 * (size_t)cols, 0);
+
+    for (j = 0; j < srcCols; j++)
+    {
+        scale.colBin[j] = (int)((long long)j * cols / srcCols);
+        scale.binCols[scale.colBin[j]]++;
+    }
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds one source row of interleaved RGB values to the running sums. When it
+ * is the last source row covered by a scaled row, the averages are rounded
+ * and stored into that row of the image and the sums are cleared.
+ *
+ * @param[in,out] scale - running sums set up by initDownscaler.
+ * @param[in,out] file - image whose arrays are sized for the scaled image.
+ * @param[in] row - index of the source row, rows must be given in order.
+ * @param[in] rgb - the source row, 3 values per pixel.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void downscaleRow(downscaler &scale, image &file, int row, const pixel *rgb)
+{
+    int j, bin;
+    unsigned long long area;
+    unsigned long long *sum;
+
+    bin = (int)((long long)row * scale.rows / scale.srcRows);
+    for (j = 0; j < scale.srcCols; j++)
+    {
+        sum = &scale.sums[3 * scale.colBin[j]];
+        sum[0] += rgb[3 * j];
+        sum[1] += rgb[3 * j + 1];
+        sum[2] += rgb[3 * j + 2];
+    }
+    scale.binRows++;
+
+    //wait until every source row of this scaled row has been added
+    if (row + 1 < scale.srcRows &&
+        (int)((long long)(row + 1) * scale.rows / scale.srcRows) == bin)
+        return;
+
+    for (j = 0; j < scale.cols; j++)
+    {
+        area = (unsigned long long)scale.binRows * scale.binCols[j];
+        sum = &scale.sums[3 * j];
+        file.redgray[bin][j] = (pixel)((sum[0] + area / 2) / area);
+        file.green[bin][j] = (pixel)((sum[1] + area / 2) / area);
+        file.blue[bin][j] = (pixel)((sum[2] + area / 2) / area);
+        sum[0] = sum[1] = sum[2] = 0;
+    }
+    scale.binRows = 0;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Shrinks an image that is already in memory down to a thumbnail. Each new
+ * pixel is the average of the block of pixels it covers. Sizes larger than
+ * the image are clamped, so the image is never enlarged.
+ *
+ * @param[in,out] file - contains all information about image, arrays are
+ *                       replaced with smaller ones.
+ * @param[in] cols - width of the thumbnail.
+ * @param[in] rows - height of the thumbnail.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool thumbnail(image &file, int cols, int rows)
+{
+    int i, j;
+    image small;
+    downscaler scale;
+    vector<pixel> rgb;
+
+    if (cols > file.cols)
+        cols = file.cols;
+    if (rows > file.rows)
+        rows = file.rows;
+
+    if (!alloc2d(small.redgray, rows, cols) ||
+        !alloc2d(small.green, rows, cols) ||
+        !alloc2d(small.blue, rows, cols))
+    {
+        free2d(small.redgray, rows); //whichever planes were allocated
+        free2d(small.green, rows);
+        free2d(small.blue, rows);
+        return false;
+    }
+
+    initDownscaler(scale, file.rows, file.cols, rows, cols);
+    rgb.resize(3 * (size_t)file.cols);
     for (i = 0; i < file.rows; i++)
     {
         for (j = 0; j < file.cols; j++)
         {
-            file.redgray[i][j] = file.newred[i][j];
-            file.green[i][j] = file.newgreen[i][j];
-            file.blue[i][j] = file.newblue[i][j];
+            rgb[3 * j] = file.redgray[i][j];
+            rgb[3 * j + 1] = file.green[i][j];
+            rgb[3 * j + 2] = file.blue[i][j];
         }
+        downscaleRow(scale, small, i, rgb.data());
     }
-    free2d(file.newred, file.rows);
-    free2d(file.newgreen, file.rows);
-    free2d(file.newblue, file.rows);
+
+    free2d(file.redgray, file.rows);
+    free2d(file.green, file.rows);
+    free2d(file.blue, file.rows);
+    file.redgray = small.redgray;
+    file.green = small.green;
+    file.blue = small.blue;
+    file.rows = rows;
+    file.cols = cols;
     return true;
 }
 
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a region written as x,y,w,h from the command line. The region is
+ * clipped to the image so only pixels that exist are read.
+ *
+ * @param[in] arg - the region argument from the command line.
+ * @param[in,out] file - image whose header has been read, the region is
+ *                       stored into it.
+ *
+ * @returns true - region was valid
+ * @returns false - region was badly written or outside of the image
+ *
+ ******************************************************************************/
+bool getRegion(string arg, image &file)
+{
+    int value[4];
+    int n = 0;
+    size_t k, start = 0;
 
+    for (k = 0; k <= arg.size(); k++)
+    {
+        if (k < arg.size() && arg[k] >= '0' && arg[k] <= '9')
+            continue;
+        if ((k < arg.size() && arg[k] != ',') || k == start ||
+            k - start > 9 || n == 4)
+            return false;
+        value[n++] = stoi(arg.substr(start, k - start));
+        start = k + 1;
+    }
+    if (n != 4 || value[0] >= file.cols || value[1] >= file.rows ||
+        value[2] == 0 || value[3] == 0)
+        return false;
 
-
+    file.roiX = value[0];
+    file.roiY = value[1];
+    file.roiCols = min(value[2], file.cols - value[0]);
+    file.roiRows = min(value[3], file.rows - value[1]);
+    return true;
+}
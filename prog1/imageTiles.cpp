@@ -0,0 +1,407 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Reads and writes the tiled format (.ptl)
+ *
+ * The file starts with a header like a '.ppm' file, magic number PT:
+ *
+   @verbatim
+   PT
+   # optional comment
+   cols rows
+   max
+   @endverbatim
+ *
+ * followed by the tile size as 4 bytes, little endian, one byte with the
+ * number of planes (1 for gray, 3 for color) and the index: the file offset
+ * of every tile as 8 bytes, little endian, tiles in rows from the top left.
+ * Tiles are square, start on a TILE_ALIGN boundary and hold each plane's
+ * rows of the tile one after the other. Tiles on the right and bottom edge
+ * are padded with 0 to the full size, so every tile is the same size and
+ * can be read with direct I/O. A tile is read with one seek and one read
+ * and copied in without looking at any other tile.
+ ******************************************************************************/
+#include "netPBM.h"
+#include <cstring>
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the bytes between the starts of two tiles: the tile's pixels,
+ * rounded up to TILE_ALIGN.
+ *
+ * @param[in] tile - width and height of a tile.
+ * @param[in] planes - number of planes, 1 or 3.
+ *
+ * @returns bytes per tile in the file
+ *
+ ******************************************************************************/
+size_t tileStride(int tile, int planes)
+{
+    size_t bytes = (size_t)tile * tile * planes;
+    return (bytes + TILE_ALIGN - 1) / TILE_ALIGN * TILE_ALIGN;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads the tile size, plane count and tile index that follow the header.
+ * If only the size and plane count are there, index is still sized, so the
+ * caller can tell how many more bytes to read.
+ *
+ * @param[in] data - bytes just after the header.
+ * @param[in] size - bytes available at data.
+ * @param[in] file - image with its size in srcRows and srcCols.
+ * @param[out] tile - width and height of a tile.
+ * @param[out] planes - number of planes, 1 or 3.
+ * @param[out] index - file offset of every tile.
+ *
+ * @returns bytes taken by the tile size, plane count and index, 0 if bad
+ *
+ ******************************************************************************/
+size_t readTileIndex(const char *data, size_t size, image &file, int &tile,
+    int &planes, vector<unsigned long long> &index)
+{
+    size_t k, b, used;
+    if (size < 5)
+        return 0;
+    tile = 0;
+    for (b = 0; b < 4; b++)
+        tile |= (unsigned char)data[b] << (8 * b);
+    planes = (unsigned char)data[4];
+    if (tile < 8 || tile > 4096 || (planes != 1 && planes != 3))
+        return 0;
+    index.assign((size_t)((file.srcCols + tile - 1) / tile) *
+        ((file.srcRows + tile - 1) / tile), 0);
+    used = 5 + 8 * index.size();
+    if (used > size)
+        return 0;
+    for (k = 0; k < index.size(); k++)
+        for (b = 0; b < 8; b++)
+            index[k] |= (unsigned long long)(unsigned char)data[5 + 8 * k +
+                b] << (8 * b);
+    return used;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Copies the part of one tile that lands inside a window of the image into
+ * the color arrays. The window is the whole image, or the region being
+ * read, given in the image's own rows and columns; the arrays hold only
+ * the window. A gray tile fills all three colors.
+ *
+ * @param[in] file - image whose arrays hold the window.
+ * @param[in] tile - width and height of a tile.
+ * @param[in] planes - number of planes in the tile, 1 or 3.
+ * @param[in] tx - column of the tile, counted in tiles.
+ * @param[in] ty - row of the tile, counted in tiles.
+ * @param[in] pixels - the tile's bytes.
+ * @param[in] x0 - left column of the window.
+ * @param[in] y0 - top row of the window.
+ * @param[in] cols - width of the window.
+ * @param[in] rows - height of the window.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void placeTile(image &file, int tile, int planes, int tx, int ty,
+    const pixel *pixels, int x0, int y0, int cols, int rows)
+{
+    int i, p, left, right, top, bottom;
+    size_t from;
+    pixel **colors[3] = { file.redgray, file.green, file.blue };
+
+    left = max(tx * tile, x0);
+    right = min(tx * tile + tile, x0 + cols);
+    top = max(ty * tile, y0);
+    bottom = min(ty * tile + tile, y0 + rows);
+    for (p = 0; p < 3 && left < right; p++)
+        for (i = top; i < bottom; i++)
+        {
+            from = ((size_t)(planes == 1 ? 0 : p) * tile + i - ty * tile) *
+                tile + left - tx * tile;
+            memcpy(colors[p][i - y0] + left - x0, pixels + from, right - left);
+        }
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a whole tiled image held in memory, tiles on every core. Tiles past
+ * the end of the data come out 0.
+ *
+ * @param[in] data - the whole file, header and all.
+ * @param[in] size - number of bytes.
+ * @param[in] file - contains all information about image, arrays are being
+ *                   accessed in this case.
+ *
+ * @returns true - image read
+ * @returns false - the tile size, plane count or index is bad
+ *
+ ******************************************************************************/
+bool decodeTiledBody(const char *data, size_t size, image &file)
+{
+    int tile, planes, across;
+    size_t stride;
+    vector<unsigned long long> index;
+
+    if (file.dataStart < 0 || (size_t)file.dataStart > size ||
+        readTileIndex(data + file.dataStart, size - (size_t)file.dataStart,
+        file, tile, planes, index) == 0)
+        return false;
+    stride = tileStride(tile, planes);
+    across = (file.cols + tile - 1) / tile;
+
+    parallelRows(0, (file.rows + tile - 1) / tile, [&](int first, int last)
+    {
+        int tx, ty;
+        size_t k;
+        vector<pixel> empty(stride, 0);
+        for (ty = first; ty < last; ty++)
+            for (tx = 0; tx < across; tx++)
+            {
+                k = (size_t)ty * across + tx;
+                placeTile(file, tile, planes, tx, ty, index[k] <= size &&
+                    stride <= size - index[k] ? (const pixel*)data + index[k] :
+                    empty.data(), 0, 0, file.cols, file.rows);
+            }
+    }, 1);
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a tiled file into the color arrays. Only the tiles that touch the
+ * image, or the region if one was set, are read. Bands of tile rows are
+ * read on every core, each thread with its own handle on the file, so the
+ * threads share nothing but the arrays they fill different parts of. If a
+ * thumbnail size was set, tile rows are read in order and averaged down as
+ * they go.
+ *
+ * @param[in] file - contains all information about image, arrays are being
+ *                   accessed in this case.
+ * @param[in] fin - ifstream for input from image file.
+ *
+ * @returns true - the tiles were read
+ * @returns false - invalid tiled image or no memory for a band of tiles,
+ *                  every pixel is 0
+ *
+ ******************************************************************************/
+bool readTiled(ifstream &fin, image &file)
+{
+    int tile = 0, planes = 1, across, i, j, tx, ty;
+    int x0 = 0, y0 = 0, cols = file.cols, rows = file.rows;
+    size_t stride, area;
+    streamoff end;
+    bool valid;
+    vector<char> meta(5);
+    vector<unsigned long long> index;
+    vector<pixel> strip, rgb;
+    downscaler scale;
+    image band;
+
+    fin.seekg(0, ios::end);
+    end = fin.tellg();
+    fin.seekg(file.dataStart);
+    fin.read(meta.data(), meta.size());
+    if (fin.gcount() == 5 && readTileIndex(meta.data(), 5, file, tile,
+        planes, index) == 0 && index.size() != 0)
+    {
+        //the size and planes are good, now the index can be read
+        meta.resize(5 + 8 * index.size());
+        fin.read(meta.data() + 5, meta.size() - 5);
+        meta.resize(5 + (size_t)fin.gcount());
+    }
+    valid = readTileIndex(meta.data(), meta.size(), file, tile, planes,
+        index) != 0;
+    if (!valid)
+    {
+        tile = 64;
+        planes = 1;
+        index.assign((size_t)((file.cols + 63) / 64) * ((file.rows + 63) /
+            64), (unsigned long long)end); //every tile comes out 0
+    }
+    stride = tileStride(tile, planes);
+    across = (file.cols + tile - 1) / tile;
+    profileBytes((long long)meta.size(), 0);
+    fin.close();
+
+    if (file.roiRows > 0)
+    {
+        x0 = file.roiX;
+        y0 = file.roiY;
+        cols = file.roiCols;
+        rows = file.roiRows;
+    }
+    if (file.thumbRows > 0) //one row of tiles at a time, in order
+    {
+        initDownscaler(scale, file.rows, file.cols, file.thumbRows,
+            file.thumbCols);
+        fin.open(file.name, ios::in | ios::binary);
+        strip.resize(stride);
+        rgb.resize(3 * (size_t)file.cols);
+        if (!alloc2d(band.redgray, tile, file.cols) ||
+            !alloc2d(band.green, tile, file.cols) ||
+            !alloc2d(band.blue, tile, file.cols))
+        {
+            valid = false;
+            across = 0; //nothing is read
+            area = (size_t)file.thumbRows * file.thumbCols;
+            memset(file.redgray[0], 0, area);
+            memset(file.green[0], 0, area);
+            memset(file.blue[0], 0, area);
+        }
+        for (ty = 0; ty * tile < file.rows && across > 0; ty++)
+        {
+            for (tx = 0; tx < across; tx++)
+            {
+                fin.clear();
+                fin.seekg((streamoff)index[(size_t)ty * across + tx]);
+                fin.read((char*)strip.data(), stride);
+                memset(strip.data() + fin.gcount(), 0, stride -
+                    (size_t)fin.gcount());
+                profileBytes(fin.gcount(), 0);
+                placeTile(band, tile, planes, tx, ty, strip.data(), 0,
+                    ty * tile, file.cols, tile);
+            }
+            for (i = 0; i < tile && ty * tile + i < file.rows; i++)
+            {
+                for (j = 0; j < file.cols; j++)
+                {
+                    rgb[3 * j] = band.redgray[i][j];
+                    rgb[3 * j + 1] = band.green[i][j];
+                    rgb[3 * j + 2] = band.blue[i][j];
+                }
+                downscaleRow(scale, file, ty * tile + i, rgb.data());
+            }
+        }
+        freeImage(band);
+        fin.close();
+        file.rows = file.thumbRows;
+        file.cols = file.thumbCols;
+        return valid;
+    }
+
+    parallelRows(y0 / tile, (y0 + rows + tile - 1) / tile,
+        [&](int first, int last)
+    {
+        int tx, ty;
+        ifstream in(file.name, ios::in | ios::binary);
+        vector<pixel> pixels(stride);
+        for (ty = first; ty < last; ty++)
+            for (tx = x0 / tile; tx * tile < x0 + cols; tx++)
+            {
+                in.clear();
+                in.seekg((streamoff)index[(size_t)ty * across + tx]);
+                in.read((char*)pixels.data(), stride);
+                memset(pixels.data() + in.gcount(), 0, stride -
+                    (size_t)in.gcount());
+                profileBytes(in.gcount(), 0);
+                placeTile(file, tile, planes, tx, ty, pixels.data(), x0, y0,
+                    cols, rows);
+            }
+    }, 1);
+    file.rows = rows;
+    file.cols = cols;
+    return valid;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes the image as tiles to outname.ptl. A grayscaled image is stored
+ * as a single plane.
+ *
+ * @param[in] file - contains all information about image, arrays are being
+ *                   accessed in this case.
+ * @param[in] fout - ofstream for output to image file
+ * @param[in] outname - output file name.
+ * @param[in] gray - bool that indicates whether or not it has been grayscaled
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void writeTiled(ofstream &fout, image &file, string outname, bool gray)
+{
+    fout.open(outname + ".ptl", ios::out | ios::trunc | ios::binary);
+    writeTiledStream(fout, file, gray);
+    profileBytes(0, fout.tellp());
+    fout.close();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes the image as TILE_SIZE tiles to any stream. Each row of tiles is
+ * cut out on every core, then written in one go.
+ *
+ * @param[in] fout - stream to write to, opened in binary.
+ * @param[in] file - contains all information about image, arrays are being
+ *                   accessed in this case.
+ * @param[in] gray - bool that indicates whether or not it has been grayscaled
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void writeTiledStream(ostream &fout, image &file, bool gray)
+{
+    int planes = gray ? 1 : 3;
+    int across = (file.cols + TILE_SIZE - 1) / TILE_SIZE;
+    int down = (file.rows + TILE_SIZE - 1) / TILE_SIZE;
+    int ty;
+    size_t stride = tileStride(TILE_SIZE, planes);
+    size_t k, b, first;
+    string head;
+    vector<char> meta;
+    vector<pixel> strip(stride * across);
+    pixel **colors[3] = { file.redgray, file.green, file.blue };
+
+    head = "PT\n";
+    if (file.comment.size() != 0)
+        head += file.comment + '\n';
+    head += to_string(file.cols) + ' ' + to_string(file.rows) + '\n' +
+        to_string(file.max) + '\n';
+    meta.assign(5 + 8 * (size_t)across * down, 0);
+    first = (head.size() + meta.size() + TILE_ALIGN - 1) / TILE_ALIGN *
+        TILE_ALIGN;
+    for (b = 0; b < 4; b++)
+        meta[b] = (char)(TILE_SIZE >> (8 * b));
+    meta[4] = (char)planes;
+    for (k = 0; k < (size_t)across * down; k++)
+        for (b = 0; b < 8; b++)
+            meta[5 + 8 * k + b] = (char)((first + k * stride) >> (8 * b));
+    meta.resize(first - head.size(), 0); //pad to the first tile
+    fout.write(head.data(), head.size());
+    fout.write(meta.data(), meta.size());
+
+    for (ty = 0; ty < down; ty++)
+    {
+        parallelRows(0, across, [&](int left, int right)
+        {
+            int tx, i, p, rows, cols;
+            pixel *tile;
+            for (tx = left; tx < right; tx++)
+            {
+                tile = &strip[tx * stride];
+                memset(tile, 0, stride);
+                rows = min(TILE_SIZE, file.rows - ty * TILE_SIZE);
+                cols = min(TILE_SIZE, file.cols - tx * TILE_SIZE);
+                for (p = 0; p < planes; p++)
+                    for (i = 0; i < rows; i++)
+                        memcpy(tile + ((size_t)p * TILE_SIZE + i) * TILE_SIZE,
+                            colors[p][ty * TILE_SIZE + i] + tx * TILE_SIZE,
+                            cols);
+            }
+        }, 1);
+        fout.write((const char*)strip.data(), strip.size());
+    }
+}
@@ -0,0 +1,259 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Functions that rotate, flip and transpose the image
+ ******************************************************************************/
+#include "netPBM.h"
+#include <algorithm>
+
+/*!
+ * @brief Blocks at or below this many pixels are transposed directly
+ */
+const int TRANSPOSE_LEAF = 64 * 64;
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Transposes one 16x16 block of pixels. With SSE2 the sixteen rows are loaded
+ * into registers and interleaved with the row eight below four times, which
+ * leaves each register holding one column of the block.
+ *
+ * @param[in] src - row pointers of the source plane.
+ * @param[in] dst - row pointers of the destination plane.
+ * @param[in] row - top row of the block in the source.
+ * @param[in] col - left column of the block in the source.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void transposeBlock16(pixel **src, pixel **dst, int row, int col)
+{
+    int k;
+#ifdef NETPBM_SSE2
+    int pass;
+    __m128i x[16], t[16];
+    for (k = 0; k < 16; k++)
+        x[k] = _mm_loadu_si128((const __m128i*)(src[row + k] + col));
+
+    for (pass = 0; pass < 4; pass++)
+    {
+        for (k = 0; k < 8; k++)
+        {
+            t[2 * k] = _mm_unpacklo_epi8(x[k], x[k + 8]);
+            t[2 * k + 1] = _mm_unpackhi_epi8(x[k], x[k + 8]);
+        }
+        for (k = 0; k < 16; k++)
+            x[k] = t[k];
+    }
+
+    for (k = 0; k < 16; k++)
+        _mm_storeu_si128((__m128i*)(dst[col + k] + row), x[k]);
+#else
+    int j;
+    for (k = 0; k < 16; k++)
+        for (j = 0; j < 16; j++)
+            dst[col + j][row + k] = src[row + k][col + j];
+#endif
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Transposes a rectangle of a plane. Large rectangles are cut in half along
+ * their longer side until they fit in cache, so the pattern works well at
+ * every cache level without being tuned to one. Small rectangles are done in
+ * 16x16 blocks with the leftover edges done one pixel at a time.
+ *
+ * @param[in] src - row pointers of the source plane.
+ * @param[in] dst - row pointers of the destination plane.
+ * @param[in] r0 - first source row of the rectangle.
+ * @param[in] r1 - one past the last source row of the rectangle.
+ * @param[in] c0 - first source column of the rectangle.
+ * @param[in] c1 - one past the last source column of the rectangle.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void transposeRect(pixel **src, pixel **dst, int r0, int r1, int c0, int c1)
+{
+    int i, j;
+    int r16, c16;
+
+    if ((long long)(r1 - r0) * (c1 - c0) > TRANSPOSE_LEAF)
+    {
+        if (r1 - r0 >= c1 - c0)
+        {
+            transposeRect(src, dst, r0, r0 + (r1 - r0) / 2, c0, c1);
+            transposeRect(src, dst, r0 + (r1 - r0) / 2, r1, c0, c1);
+        }
+        else
+        {
+            transposeRect(src, dst, r0, r1, c0, c0 + (c1 - c0) / 2);
+            transposeRect(src, dst, r0, r1, c0 + (c1 - c0) / 2, c1);
+        }
+        return;
+    }
+
+    r16 = r0 + (r1 - r0) / 16 * 16;
+    c16 = c0 + (c1 - c0) / 16 * 16;
+    for (i = r0; i < r16; i += 16)
+        for (j = c0; j < c16; j += 16)
+            transposeBlock16(src, dst, i, j);
+
+    for (i = r0; i < r1; i++) //right edge
+        for (j = c16; j < c1; j++)
+            dst[j][i] = src[i][j];
+    for (i = r16; i < r1; i++) //bottom edge
+        for (j = c0; j < c16; j++)
+            dst[j][i] = src[i][j];
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Transposes every color of the image into new arrays, swapping its rows and
+ * columns. The source or destination rows can be visited bottom up, which
+ * turns the transpose into a quarter turn without a second pass.
+ *
+ * @param[in,out] file - contains all information about image, arrays are
+ *                       replaced with the transposed ones.
+ * @param[in] flipSrc - read the source rows from the bottom up.
+ * @param[in] flipDst - write the destination rows from the bottom up.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool transposeImage(image &file, bool flipSrc, bool flipDst)
+{
+    int i, k;
+    pixel **planes[3] = { file.redgray, file.green, file.blue };
+    pixel **newPlanes[3];
+    vector<pixel*> src(file.rows), dst(file.cols);
+
+    if (!alloc2d(file.newred, file.cols, file.rows) ||
+        !alloc2d(file.newgreen, file.cols, file.rows) ||
+        !alloc2d(file.newblue, file.cols, file.rows))
+    {
+        return false;
+    }
+    newPlanes[0] = file.newred;
+    newPlanes[1] = file.newgreen;
+    newPlanes[2] = file.newblue;
+
+    for (k = 0; k < 3; k++)
+    {
+        for (i = 0; i < file.rows; i++)
+            src[i] = planes[k][flipSrc ? file.rows - 1 - i : i];
+        for (i = 0; i < file.cols; i++)
+            dst[i] = newPlanes[k][flipDst ? file.cols - 1 - i : i];
+        transposeRect(src.data(), dst.data(), 0, file.rows, 0, file.cols);
+    }
+
+    free2d(file.redgray, file.rows);
+    free2d(file.green, file.rows);
+    free2d(file.blue, file.rows);
+    file.redgray = file.newred;
+    file.green = file.newgreen;
+    file.blue = file.newblue;
+    file.newred = file.newgreen = file.newblue = nullptr;
+    swap(file.rows, file.cols);
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Transposes the image, so row i becomes column i.
+ *
+ * @param[in,out] file - contains all information about image, arrays are
+ *                       being accessed in this case.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool transpose(image &file)
+{
+    return transposeImage(file, false, false);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Rotates the image clockwise by 90, 180 or 270 degrees. Quarter turns are
+ * transposes with the rows visited bottom up, a half turn is done in place.
+ *
+ * @param[in,out] file - contains all information about image, arrays are
+ *                       being accessed in this case.
+ * @param[in] degrees - 90, 180 or 270.
+ *
+ * @returns true - image rotated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool rotate(image &file, int degrees)
+{
+    if (degrees == 90)
+        return transposeImage(file, true, false);
+    if (degrees == 270)
+        return transposeImage(file, false, true);
+
+    flipVertical(file);
+    flipHorizontal(file);
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Mirrors the image left to right by reversing every row.
+ *
+ * @param[in,out] file - contains all information about image, arrays are
+ *                       being accessed in this case.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void flipHorizontal(image &file)
+{
+    int i;
+    for (i = 0; i < file.rows; i++)
+    {
+        reverse(file.redgray[i], file.redgray[i] + file.cols);
+        reverse(file.green[i], file.green[i] + file.cols);
+        reverse(file.blue[i], file.blue[i] + file.cols);
+    }
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Mirrors the image top to bottom by swapping whole rows.
+ *
+ * @param[in,out] file - contains all information about image, arrays are
+ *                       being accessed in this case.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void flipVertical(image &file)
+{
+    int i;
+    for (i = 0; i < file.rows / 2; i++)
+    {
+        swap_ranges(file.redgray[i], file.redgray[i] + file.cols,
+            file.redgray[file.rows - 1 - i]);
+        swap_ranges(file.green[i], file.green[i] + file.cols,
+            file.green[file.rows - 1 - i]);
+        swap_ranges(file.blue[i], file.blue[i] + file.cols,
+            file.blue[file.rows - 1 - i]);
+    }
+}
@@ -0,0 +1,46 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief The pixel and image types shared by the program and the library
+ *
+ * Kept apart from netPBM.h so the library header can use them without
+ * bringing in the rest of the program's declarations.
+ ******************************************************************************/
+#include <ios>
+#include <string>
+
+#ifndef __IMAGETYPES__H__
+#define __IMAGETYPES__H__
+
+/*!
+ * @brief Pixel contains a value for a single pixel within an image.
+ */
+typedef unsigned char pixel;
+/*!
+ * @brief Holds information about an image
+ */
+struct image
+{
+    std::string name;           /*!< The name of the file*/
+    std::string comment;        /*!< The comment in the file*/
+    std::string header;         /*!< The magic number in the file*/
+    int rows;                   /*!< The amount of rows for the image*/
+    int cols;                   /*!< The amount of columns for the image*/
+    int max;                    /*!< The max pixel value for the image*/
+    pixel **redgray = nullptr;  /*!< Pointer to 2D array for red and gray values*/
+    pixel **green = nullptr;    /*!< Pointer to 2D array for green values*/
+    pixel **blue = nullptr;     /*!< Pointer to 2D array for blue values*/
+    pixel **newred = nullptr;   /*!< Pointer to 2D array to hold new red values*/
+    pixel **newgreen = nullptr; /*!< Pointer to 2D array to hold new green values*/
+    pixel **newblue = nullptr;  /*!< Pointer to 2D array to hold new blue values*/
+    int thumbRows = 0;          /*!< Rows to shrink to while decoding, 0 = off*/
+    int thumbCols = 0;          /*!< Cols to shrink to while decoding, 0 = off*/
+    int srcRows = 0;            /*!< The amount of rows stored in the file*/
+    int srcCols = 0;            /*!< The amount of columns stored in the file*/
+    int roiX = 0;               /*!< Left column of the region to read*/
+    int roiY = 0;               /*!< Top row of the region to read*/
+    int roiRows = 0;            /*!< Rows in the region to read, 0 = off*/
+    int roiCols = 0;            /*!< Columns in the region to read, 0 = off*/
+    std::streamoff dataStart = 0; /*!< File offset of the first pixel value*/
+};
+#endif
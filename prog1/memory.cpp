@@ -4,12 +4,168 @@
  * @brief Handles the allocation and freeing up of memory
  ******************************************************************************/
 #include "netPBM.h"
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/*!
+ * @brief Start of every chunk, kept so free2d knows the size of the chunk
+ */
+struct poolHeader
+{
+    size_t bytes;           /*!< Size of the whole chunk*/
+};
+
+const size_t POOL_ALIGN = 64;            /*!< Alignment of the pixel block*/
+const size_t POOL_PAGE = 4096;           /*!< Chunks are whole pages*/
+const size_t POOL_HUGE_PAGE = 2 << 20;   /*!< Size of one huge page*/
+const size_t POOL_KEEP_BYTES = 512 << 20;/*!< Most bytes kept for reuse*/
+
+static mutex poolLock;                   /*!< Guards the free lists*/
+static map<size_t, vector<char*>> pool;  /*!< Free chunks by size class*/
+static size_t poolBytes = 0;             /*!< Bytes sitting in the free lists*/
+static bool hugePages = false;           /*!< Back big chunks by huge pages*/
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Turns huge pages on or off for chunks of at least one huge page. On Linux
+ * the kernel is asked to back them with transparent huge pages, on Windows
+ * large pages are used if the user has the lock pages privilege. Anywhere
+ * they can't be had normal pages are used.
+ *
+ * @param[in] on - true to use huge pages for big chunks.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void setHugePages(bool on)
+{
+    hugePages = on;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Rounds a request up to the chunk size it is pooled under. Small chunks
+ * are whole pages, big ones go up in steps of a quarter of their power of
+ * two, so a plane and its transpose or a slightly different image size land
+ * on the same free list while at most a fifth of a chunk is wasted.
+ *
+ * @param[in] bytes - bytes asked for.
+ *
+ * @returns size of the chunk to hand out
+ *
+ ******************************************************************************/
+size_t poolClassSize(size_t bytes)
+{
+    size_t step = POOL_PAGE;
+    while (step * 8 < bytes)
+        step *= 2;
+    bytes = (bytes + step - 1) / step * step;
+    if (hugePages && bytes >= POOL_HUGE_PAGE)
+        bytes = (bytes + POOL_HUGE_PAGE - 1) / POOL_HUGE_PAGE * POOL_HUGE_PAGE;
+    return bytes;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets a chunk of fresh pages straight from the operating system.
+ *
+ * @param[in] bytes - size of the chunk, a whole number of pages.
+ *
+ * @returns the chunk, or nullptr if there is no memory
+ *
+ ******************************************************************************/
+char *poolMapChunk(size_t bytes)
+{
+    char *chunk = nullptr;
+#ifdef _WIN32
+    size_t large = GetLargePageMinimum();
+    if (hugePages && large > 0 && bytes % large == 0)
+        chunk = (char*)VirtualAlloc(nullptr, bytes, MEM_COMMIT | MEM_RESERVE |
+            MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (chunk == nullptr)
+        chunk = (char*)VirtualAlloc(nullptr, bytes, MEM_COMMIT | MEM_RESERVE,
+            PAGE_READWRITE);
+#else
+    chunk = (char*)mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk == (char*)MAP_FAILED)
+        return nullptr;
+#ifdef MADV_HUGEPAGE
+    if (hugePages && bytes >= POOL_HUGE_PAGE)
+        madvise(chunk, bytes, MADV_HUGEPAGE); //only a hint, fine if refused
+#endif
+#endif
+    if (chunk == nullptr)
+        return nullptr;
+    ((poolHeader*)chunk)->bytes = bytes;
+    return chunk;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gives a chunk back to the operating system.
+ *
+ * @param[in] chunk - chunk from poolMapChunk.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void poolUnmapChunk(char *chunk)
+{
+#ifdef _WIN32
+    VirtualFree(chunk, 0, MEM_RELEASE);
+#else
+    munmap(chunk, ((poolHeader*)chunk)->bytes);
+#endif
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gives every chunk waiting in the pool back to the operating system.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void releasePool()
+{
+    size_t k;
+    lock_guard<mutex> hold(poolLock);
+    for (auto &list : pool)
+        for (k = 0; k < list.second.size(); k++)
+            poolUnmapChunk(list.second[k]);
+    pool.clear();
+    poolBytes = 0;
+}
+
 /***************************************************************************//**
  * @author Dillon Roller
  *
  * @par Description:
  * This function is responsible for the dynamic allocation of memory for 
- * arrays. 
+ * arrays. The row pointers and all of the pixels share one contiguous,
+ * page backed chunk, with the pixels starting on a cache line, so whole
+ * planes can be walked and copied without jumping between separate row
+ * allocations. Chunks come from a pool, so planes freed by one operation
+ * or image are handed straight to the next one of a similar size with
+ * their pages already mapped in. The pixels of a reused chunk are not
+ * cleared.
  *
  * @param[in] arr - pointer to allocate memory 
  * @param[in] rows - number of rows in picture
@@ -21,19 +177,37 @@
 bool alloc2d( pixel** &arr, int rows, int cols ) 
 {
     int i;
-    arr = new (nothrow) pixel*[rows];
-    if (arr == nullptr)
-        return false;
-    
-    for (i = 0; i < rows; i++)
+    size_t pointers, bytes;
+    char *chunk = nullptr;
+    pixel *block;
+
+    pointers = (sizeof(pixel*) * (rows > 0 ? rows : 1) + POOL_ALIGN - 1) /
+        POOL_ALIGN * POOL_ALIGN;
+    bytes = poolClassSize(POOL_ALIGN + pointers + (size_t)rows * cols);
     {
-        arr[i] = new (nothrow) pixel[cols];
-        if (arr[i] == nullptr)
+        lock_guard<mutex> hold(poolLock);
+        auto list = pool.find(bytes);
+        if (list != pool.end() && !list->second.empty())
         {
-            free2d(arr, i);
-            return false;
+            chunk = list->second.back();
+            list->second.pop_back();
+            poolBytes -= bytes;
         }
     }
+    profileAlloc((long long)bytes, chunk != nullptr);
+    if (chunk == nullptr)
+        chunk = poolMapChunk(bytes);
+    if (chunk == nullptr)
+    {
+        arr = nullptr;
+        return false;
+    }
+
+    arr = (pixel**)(chunk + POOL_ALIGN); //just past the header
+    block = (pixel*)chunk + POOL_ALIGN + pointers;
+    arr[0] = block;
+    for (i = 1; i < rows; i++)
+        arr[i] = block + (size_t)i * cols;
     return true;
 }
 
@@ -42,21 +216,55 @@ bool alloc2d( pixel** &arr, int rows, int cols )
  *
  * @par Description:
  * This function frees up dynamically allocated arrays after they are done 
- * being used.
+ * being used. The chunk goes back to the pool for the next allocation of
+ * its size, unless the pool already holds POOL_KEEP_BYTES.
  *
- * @param[in] arr - pointer to dynamically allocated array
- * @param[in] rows - number of 1D arrays to free up in 2D array
+ * @param[in] arr - pointer to dynamically allocated array, set to nullptr
+ * @param[in] rows - number of 1D arrays in 2D array, not needed as the
+ *                   chunk keeps its size
  *
  * @returns nothing
  *
  ******************************************************************************/
-void free2d(pixel** &arr, int rows)
+void free2d(pixel** &arr, int /*rows*/)
 {
-    int i;
+    char *chunk;
+    size_t bytes;
     if (arr == nullptr)
         return;
 
-    for (i = 0; i < rows; i++)
-        delete[] arr[i];
-    delete[] arr;
-}
\ No newline at end of file
+    chunk = (char*)arr - POOL_ALIGN; //row pointers follow the header
+    bytes = ((poolHeader*)chunk)->bytes;
+    arr = nullptr;
+    {
+        lock_guard<mutex> hold(poolLock);
+        if (poolBytes + bytes <= POOL_KEEP_BYTES)
+        {
+            pool[bytes].push_back(chunk);
+            poolBytes += bytes;
+            return;
+        }
+    }
+    poolUnmapChunk(chunk);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Frees every array held by an image.
+ *
+ * @param[in] file - image whose arrays are freed and set to nullptr.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void freeImage(image &file)
+{
+    free2d(file.redgray, file.rows);
+    free2d(file.green, file.rows);
+    free2d(file.blue, file.rows);
+    free2d(file.newred, file.rows);
+    free2d(file.newgreen, file.rows);
+    free2d(file.newblue, file.rows);
+}
@@ -34,7 +34,7 @@
  *      Program is ran from command prompt and files are placed into same
  *      folder as the executable. Run from the command line in the following
  *      way:\n\n
- *      C:\>prog1.exe [option] -o[a or b] outputname inputname.ppm
+ *      C:\>prog1.exe [option] -o[a, b, c or t] outputname inputname.ppm
  *
    @verbatim
    Option Code:     Option Name:
@@ -44,6 +44,44 @@
    -s               Smooth
    -g               Grayscale
    -c               Contrast
+   -t WxH           Thumbnail (area averaged, decoded directly at this size
+                    when it is the first option)
+   -r x,y,w,h       Region (must be the first option, only the region is
+                    read and processed)
+   -R #             Rotate clockwise by 90, 180 or 270 degrees
+   -fh              Flip horizontally (mirror left to right)
+   -fv              Flip vertically (mirror top to bottom)
+   -x               Transpose
+   -e               Edges (Sobel gradient magnitude of the grayscaled image,
+                    done in the same pass as -g when it follows -g)
+  -a #             Adaptive threshold (black where a pixel is darker than
+                   the mean of the window of this radius around it)
+  -l #             Local contrast (normalize each pixel by the mean and
+                   deviation of the window of this radius around it)
+   --bench [file]   Time every operation and format on generated images,
+                    writing CSV results to file (or the screen)
+   --verify         Check the optimized operations against the original
+                    versions on generated and edge case images
+   -oc              Output a compressed container (.pzc), which can also be
+                    read as input, with regions and thumbnails decoded
+                    from only the rows they need
+   -ot              Output a tiled image (.ptl) of 64x64 tiles, which can
+                    also be read as input, with regions reading only the
+                    tiles they touch
+   -op              Output the processed region patched into a copy of the
+                    binary input (in place if outputname.ppm is the input)
+   --profile        Before any other option: print a JSON summary of the
+                    time, CPU, bytes and memory of each stage of the run
+   --trace file     Before any other option: also write the stages as
+                    Chrome trace events to file (implies --profile)
+   --hugepages      Before any other option: back large image planes with
+                    huge pages where the system allows it
+   --cache dir      Before any other option: reuse the output of an earlier
+                    run with the same input bytes and options from dir,
+                    storing this run's output there if it is not found
+   --cache-size #   Before any other option: megabytes the cache may hold,
+                    least recently used outputs are removed past it
+                    (default 1024)
    @endverbatim
  *
  * @par Usage:
@@ -79,49 +117,204 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <cmath>
+#include <functional>
+#include "imageTypes.h"
 
 using namespace std;
 
 #ifndef __NETPBM__H__
 #define __NETPBM__H__
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NETPBM_SSE2  /*!< SSE2 kernels are used instead of plain loops*/
+#endif
+
+/*!
+ * @brief ASCII bodies are only split into chunks of about this many bytes
+ */
+const size_t ASCII_CHUNK_SIZE = 1 << 16;
+/*!
+ * @brief Fewest rows handed to one thread, smaller bands are not worth it
+ */
+const int MIN_BAND_ROWS = 16;
+/*!
+ * @brief Megabytes the result cache may hold unless --cache-size is given
+ */
+const int CACHE_DEFAULT_MB = 1024;
+/*!
+ * @brief Width and height of the tiles written to tiled files
+ */
+const int TILE_SIZE = 64;
+/*!
+ * @brief Tiles start on a multiple of this, so they can be read directly
+ */
+const size_t TILE_ALIGN = 4096;
+/*!
+ * @brief Percent darker than its window's mean a pixel must be to go black
+ */
+const int ADAPTIVE_PERCENT = 15;
+/*!
+ * @brief Values one standard deviation lands from 128 in local contrast
+ */
+const double LOCAL_GAIN = 48;
 /*!
- * @brief Pixel contains a value for a single pixel within an image.
+ * @brief Smallest standard deviation local contrast divides by
  */
-typedef unsigned char pixel;
+const double LOCAL_MIN_DEVIATION = 8;
+/*!
+ * @brief Running sums used to area average source rows into a smaller image
+ */
+struct downscaler
+{
+    int srcRows;                     /*!< Rows in the source image*/
+    int srcCols;                     /*!< Columns in the source image*/
+    int rows;                        /*!< Rows in the scaled image*/
+    int cols;                        /*!< Columns in the scaled image*/
+    int binRows;                     /*!< Source rows summed into current row*/
+    vector<int> colBin;              /*!< Scaled column for each source column*/
+    vector<int> binCols;             /*!< Source columns in each scaled column*/
+    vector<unsigned long long> sums; /*!< RGB sums for the current scaled row*/
+};
+
+/*!
+ * @brief Sums of the rectangles of a plane that start at its top left
+ */
+struct integralImage
+{
+    int rows;                           /*!< Rows in the plane*/
+    int cols;                           /*!< Columns in the plane*/
+    vector<unsigned long long> sums;    /*!< (rows+1)x(cols+1) sums of values*/
+    vector<unsigned long long> squares; /*!< Same for squares, or empty*/
+};
+
 /*!
- * @brief Holds information about an image
+ * @brief A profile stage that ends when it goes out of scope, so every way
+ *        out of the stage ends it
  */
-struct image
+struct profileScope
 {
-    string name;                /*!< The name of the file*/
-    string comment;             /*!< The comment in the file*/
-    string header;              /*!< The magic number in the file*/
-    int rows;                   /*!< The amount of rows for the image*/
-    int cols;                   /*!< The amount of columns for the image*/
-    int max;                    /*!< The max pixel value for the image*/
-    pixel **redgray = nullptr;  /*!< Pointer to 2D array for red and gray values*/
-    pixel **green = nullptr;    /*!< Pointer to 2D array for green values*/
-    pixel **blue = nullptr;     /*!< Pointer to 2D array for blue values*/
-    pixel **newred = nullptr;   /*!< Pointer to 2D array to hold new red values*/
-    pixel **newgreen = nullptr; /*!< Pointer to 2D array to hold new green values*/
-    pixel **newblue = nullptr;  /*!< Pointer to 2D array to hold new blue values*/
+    int stage;                  /*!< Number from profileBegin, -1 when ended*/
+    explicit profileScope(const string &name);
+    ~profileScope();
+    void end();
 };
 
 /*******************************************************************************
  *                         Function Prototypes
  ******************************************************************************/
 bool readHeaderInfo(ifstream &fin, image &file);
+bool readHeaderStream(istream &fin, image &file);
 bool alloc2d(pixel** &arr, int rows, int cols);
 void free2d(pixel** &arr, int rows);
+void setHugePages(bool on);
+size_t poolClassSize(size_t bytes);
+char *poolMapChunk(size_t bytes);
+void poolUnmapChunk(char *chunk);
+void releasePool();
 void readBinaryRGB(ifstream &fin, image &file);
 void readAsciiRGB(ifstream &fin, image &file);
 void negate(image &file);
 void grayscale(image &file);
 void writeAscii(ofstream &fout, image &file, string outname, bool gray);
 void writeBinary(ofstream &fout, image &file, string outname, bool gray);
+void writeAsciiStream(ostream &fout, image &file, bool gray);
+void writeBinaryStream(ostream &fout, image &file, bool gray);
+size_t packRow(const pixel *row, int cols, pixel *out);
+void unpackRow(const pixel *in, size_t size, pixel *row, int cols);
+size_t readContainerIndex(const char *data, size_t size, int rows,
+    int &planes, vector<unsigned long long> &index);
+bool decodeCompressedBody(const char *data, size_t size, image &file);
+bool readCompressed(ifstream &fin, image &file);
+void writeCompressed(ofstream &fout, image &file, string outname, bool gray);
+void writeCompressedStream(ostream &fout, image &file, bool gray);
+size_t tileStride(int tile, int planes);
+size_t readTileIndex(const char *data, size_t size, image &file, int &tile,
+    int &planes, vector<unsigned long long> &index);
+void placeTile(image &file, int tile, int planes, int tx, int ty,
+    const pixel *pixels, int x0, int y0, int cols, int rows);
+bool decodeTiledBody(const char *data, size_t size, image &file);
+bool readTiled(ifstream &fin, image &file);
+void writeTiled(ofstream &fout, image &file, string outname, bool gray);
+void writeTiledStream(ostream &fout, image &file, bool gray);
 void brighten(image &file, int value);
 void getMinAndMax(image &file, int &min, int &max);
 void contrast(image &file);
 bool sharpen(image &file);
 bool smooth(image &file);
+bool getThumbSize(string arg, int &cols, int &rows);
+void initDownscaler(downscaler &scale, int srcRows, int srcCols, int rows,
+    int cols);
+void downscaleRow(downscaler &scale, image &file, int row, const pixel *rgb);
+bool thumbnail(image &file, int cols, int rows);
+bool getRegion(string arg, image &file);
+bool canPatch(const image &file);
+bool writePatch(image &file, string outname, bool gray);
+void transposeBlock16(pixel **src, pixel **dst, int row, int col);
+void transposeRect(pixel **src, pixel **dst, int r0, int r1, int c0, int c1);
+bool transposeImage(image &file, bool flipSrc, bool flipDst);
+bool transpose(image &file);
+bool rotate(image &file, int degrees);
+void flipHorizontal(image &file);
+void flipVertical(image &file);
+pixel luma(pixel r, pixel g, pixel b);
+void sobelRow(const pixel *above, const pixel *middle, const pixel *below,
+    pixel *out, int cols);
+bool sobel(image &file, bool gray);
+void buildIntegral(pixel **plane, int rows, int cols, integralImage &table,
+    bool squares);
+unsigned long long integralSum(const vector<unsigned long long> &sums,
+    int cols, int top, int left, int bottom, int right);
+pixel adaptiveValue(pixel value, unsigned long long sum,
+    unsigned long long area);
+pixel localContrastValue(pixel value, unsigned long long sum,
+    unsigned long long squares, unsigned long long area);
+bool adaptiveThreshold(image &file, int radius, bool gray);
+bool localContrast(image &file, int radius, bool gray);
+void setThreadCount(int count);
+int getThreadCount();
+void parallelRows(int first, int last, const function<void(int, int)> &work,
+    int minBand = MIN_BAND_ROWS);
+const char *nextAsciiValue(const char *p, const char *end, int &value);
+bool readAsciiValue(istream &fin, string &line, size_t &pos, int &value);
+void decodeAsciiBody(const char *data, size_t size, image &file);
+void formatAsciiRows(image &file, int first, int last, bool gray,
+    vector<char> &out);
+void freeImage(image &file);
+bool makeTestImage(image &file, int rows, int cols, unsigned seed);
+void copyPixels(const image &src, image &dst);
+bool runBenchmarks(string outname);
+void refNegate(image &file);
+void refGrayscale(image &file);
+void refBrighten(image &file, int value);
+void refContrast(image &file);
+void refFilter(image &file, bool sharp);
+void refSobel(image &file);
+void refWindows(image &file, int radius, bool threshold);
+void refMove(image &file, int how);
+void refThumbnail(image &file, int cols, int rows);
+string refFormatAscii(image &file, bool gray);
+void makeVerifyImage(image &file, int rows, int cols, int value);
+bool sameImage(image &fast, image &ref, string name);
+bool runVerify();
+double processCpuMicros();
+long long peakResidentKB();
+void profileStart(string trace);
+int profileBegin(const string &name);
+void profileEnd(int stage);
+void profileBytes(long long read, long long written);
+void profileAlloc(long long bytes, bool pooled);
+void writeJsonString(ostream &out, const string &text);
+void profileReport(int exitCode);
+int processImage(int argc, char **argv, vector<string> &outputs);
+unsigned long long hashBytes(const char *data, size_t size,
+    unsigned long long seed);
+string cacheKey(int argc, char **argv);
+bool copyFile(const string &from, const string &to);
+bool replaceFile(const string &from, const string &to);
+int cachedRun(string dir, long long limit, int argc, char **argv,
+    const function<int(int, char**, vector<string>&)> &run);
 #endif
\ No newline at end of file
@@ -0,0 +1,915 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Image objects that own their memory, for use as a library
+ ******************************************************************************/
+#include "netPBM.h"
+#include "netpbmlib.h"
+#include <sstream>
+
+/*!
+ * @brief Stream buffer reading straight out of memory someone else owns
+ */
+struct memoryBuffer : streambuf
+{
+    /*!
+     * @brief Reads the bytes [data, data + size)
+     */
+    memoryBuffer(const char *data, size_t size)
+    {
+        setg((char*)data, (char*)data, (char*)data + size);
+    }
+
+    /*!
+     * @brief Lets tellg and seekg work the same as on a file
+     */
+    pos_type seekoff(off_type off, ios::seekdir dir,
+        ios::openmode /*which*/) override
+    {
+        char *to = dir == ios::beg ? eback() : dir == ios::cur ? gptr() :
+            egptr();
+        if (to + off < eback() || to + off > egptr())
+            return pos_type(off_type(-1));
+        setg(eback(), to + off, egptr());
+        return pos_type(gptr() - eback());
+    }
+};
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Makes an empty image with no planes.
+ *
+ ******************************************************************************/
+pbmImage::pbmImage() : file()
+{
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Makes a color image of the given size with a max value of 255. The pixels
+ * are not cleared. If there is not enough memory the image is empty.
+ *
+ * @param[in] rows - height of the image.
+ * @param[in] cols - width of the image.
+ *
+ ******************************************************************************/
+pbmImage::pbmImage(int rows, int cols) : file()
+{
+    file.header = "P6";
+    file.rows = file.srcRows = rows;
+    file.cols = file.srcCols = cols;
+    file.max = 255;
+    if (!alloc2d(file.redgray, rows, cols) || !alloc2d(file.green, rows, cols)
+        || !alloc2d(file.blue, rows, cols))
+        release();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Frees the planes.
+ *
+ ******************************************************************************/
+pbmImage::~pbmImage()
+{
+    freeImage(file);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Takes the planes of another image, leaving it empty.
+ *
+ * @param[in,out] other - image to take from.
+ *
+ ******************************************************************************/
+pbmImage::pbmImage(pbmImage &&other) noexcept : file(move(other.file)),
+    isGray(other.isGray)
+{
+    other.file = image();
+    other.isGray = false;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Frees this image's planes and takes the planes of another, leaving it
+ * empty.
+ *
+ * @param[in,out] other - image to take from.
+ *
+ * @returns this image
+ *
+ ******************************************************************************/
+pbmImage &pbmImage::operator=(pbmImage &&other) noexcept
+{
+    if (this == &other)
+        return *this;
+    freeImage(file);
+    file = move(other.file);
+    isGray = other.isGray;
+    other.file = image();
+    other.isGray = false;
+    return *this;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a '.ppm' file, P3 or P6, a '.pzc' container or a '.ptl' tiled file.
+ *
+ * @param[in] path - name of the file.
+ *
+ * @returns the image, empty if the file could not be read or is not a valid
+ *          container or tiled file
+ *
+ ******************************************************************************/
+pbmImage pbmImage::decodeFile(const string &path)
+{
+    pbmImage img;
+    ifstream fin;
+    img.file.name = path;
+    if (!readHeaderInfo(fin, img.file))
+        return pbmImage();
+    if (!alloc2d(img.file.redgray, img.file.rows, img.file.cols) ||
+        !alloc2d(img.file.green, img.file.rows, img.file.cols) ||
+        !alloc2d(img.file.blue, img.file.rows, img.file.cols))
+        return pbmImage();
+    if (img.file.header == "P6")
+        readBinaryRGB(fin, img.file);
+    else if (img.file.header == "PZ")
+    {
+        if (!readCompressed(fin, img.file))
+            return pbmImage();
+    }
+    else if (img.file.header == "PT")
+    {
+        if (!readTiled(fin, img.file))
+            return pbmImage();
+    }
+    else
+        readAsciiRGB(fin, img.file);
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads an image held in memory, laid out the same as a '.ppm' file, P3 or
+ * P6, a '.pzc' container or a '.ptl' tiled file. The bytes are read in
+ * place, nothing is copied but the pixels. Values missing from a short
+ * image are set to 0, as when reading a file.
+ *
+ * @param[in] data - first byte of the image.
+ * @param[in] size - number of bytes.
+ *
+ * @returns the image, empty if the header is bad or memory ran out
+ *
+ ******************************************************************************/
+pbmImage pbmImage::decodeMemory(const char *data, size_t size)
+{
+    pbmImage img;
+    memoryBuffer buffer(data, size);
+    istream in(&buffer);
+    size_t start;
+
+    if (!readHeaderStream(in, img.file) || img.file.dataStart < 0)
+        return pbmImage();
+    if (!alloc2d(img.file.redgray, img.file.rows, img.file.cols) ||
+        !alloc2d(img.file.green, img.file.rows, img.file.cols) ||
+        !alloc2d(img.file.blue, img.file.rows, img.file.cols))
+        return pbmImage();
+    start = (size_t)img.file.dataStart;
+    if (img.file.header == "P3")
+    {
+        decodeAsciiBody(data + start, size - start, img.file);
+        return img;
+    }
+    if (img.file.header == "PZ")
+    {
+        if (!decodeCompressedBody(data + start, size - start, img.file))
+            return pbmImage();
+        return img;
+    }
+    if (img.file.header == "PT")
+    {
+        if (!decodeTiledBody(data, size, img.file))
+            return pbmImage();
+        return img;
+    }
+
+    parallelRows(0, img.file.rows, [&](int first, int last)
+    {
+        int i, j;
+        size_t at;
+        for (i = first; i < last; i++)
+            for (j = 0; j < img.file.cols; j++)
+            {
+                at = start + 3 * ((size_t)i * img.file.cols + j);
+                img.file.redgray[i][j] = at < size ? data[at] : 0;
+                img.file.green[i][j] = at + 1 < size ? data[at + 1] : 0;
+                img.file.blue[i][j] = at + 2 < size ? data[at + 2] : 0;
+            }
+    });
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes the image to outname.ppm, or outname.pgm once it is gray, the same
+ * as the -oa and -ob options.
+ *
+ * @param[in] outname - output file name without its extension.
+ * @param[in] binary - true for P6 or P5, false for P3 or P2.
+ *
+ * @returns true - file written
+ * @returns false - the image is empty or the file could not be written
+ *
+ ******************************************************************************/
+bool pbmImage::encodeFile(const string &outname, bool binary)
+{
+    ofstream fout;
+    if (empty())
+        return false;
+    if (binary)
+        writeBinary(fout, file, outname, isGray);
+    else
+        writeAscii(fout, file, outname, isGray);
+    return !fout.fail();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the bytes encodeFile would write.
+ *
+ * @param[in] binary - true for P6 or P5, false for P3 or P2.
+ *
+ * @returns the encoded image, empty if the image is empty
+ *
+ ******************************************************************************/
+string pbmImage::encodeMemory(bool binary)
+{
+    ostringstream out(ios::out | ios::binary);
+    if (empty())
+        return string();
+    if (binary)
+        writeBinaryStream(out, file, isGray);
+    else
+        writeAsciiStream(out, file, isGray);
+    return out.str();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Makes a copy of the image with planes of its own.
+ *
+ * @returns the copy, empty if memory ran out
+ *
+ ******************************************************************************/
+pbmImage pbmImage::clone() const
+{
+    pbmImage copy;
+    if (empty())
+        return copy;
+    copy.file.name = file.name;
+    copy.file.comment = file.comment;
+    copy.file.header = file.header;
+    copy.file.rows = file.rows;
+    copy.file.cols = file.cols;
+    copy.file.max = file.max;
+    copy.file.srcRows = file.srcRows;
+    copy.file.srcCols = file.srcCols;
+    copy.isGray = isGray;
+    if (!alloc2d(copy.file.redgray, file.rows, file.cols) ||
+        !alloc2d(copy.file.green, file.rows, file.cols) ||
+        !alloc2d(copy.file.blue, file.rows, file.cols))
+        return pbmImage();
+    copyPixels(file, copy.file);
+    return copy;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Frees the planes now, leaving the image empty.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void pbmImage::release()
+{
+    freeImage(file);
+    file = image();
+    isGray = false;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Checks if the image has no planes.
+ *
+ * @returns true if there are no pixels
+ *
+ ******************************************************************************/
+bool pbmImage::empty() const
+{
+    return file.redgray == nullptr;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the height of the image.
+ *
+ * @returns number of rows, 0 if empty
+ *
+ ******************************************************************************/
+int pbmImage::rows() const
+{
+    return empty() ? 0 : file.rows;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the width of the image.
+ *
+ * @returns number of columns, 0 if empty
+ *
+ ******************************************************************************/
+int pbmImage::cols() const
+{
+    return empty() ? 0 : file.cols;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Checks if the image has been grayscaled, so only plane 0 holds it.
+ *
+ * @returns true if the image is gray
+ *
+ ******************************************************************************/
+bool pbmImage::gray() const
+{
+    return isGray;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the pixels of one color, rows()*cols() values one row after another.
+ *
+ * @param[in] color - 0 for red or gray, 1 for green, 2 for blue.
+ *
+ * @returns first pixel of the plane, nullptr if empty
+ *
+ ******************************************************************************/
+pixel *pbmImage::plane(int color)
+{
+    pixel **planes[3] = { file.redgray, file.green, file.blue };
+    return empty() || color < 0 || color > 2 ? nullptr : planes[color][0];
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the pixels of one color, rows()*cols() values one row after another.
+ *
+ * @param[in] color - 0 for red or gray, 1 for green, 2 for blue.
+ *
+ * @returns first pixel of the plane, nullptr if empty
+ *
+ ******************************************************************************/
+const pixel *pbmImage::plane(int color) const
+{
+    return const_cast<pbmImage*>(this)->plane(color);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the image struct underneath, for calling the functions in netPBM.h
+ * directly. The planes stay owned by this object.
+ *
+ * @returns the image struct
+ *
+ ******************************************************************************/
+image &pbmImage::raw()
+{
+    return file;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Negates the image in place.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void pbmImage::negate()
+{
+    ::negate(file);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Brightens the image in place.
+ *
+ * @param[in] value - amount to add to every pixel, may be negative.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void pbmImage::brighten(int value)
+{
+    ::brighten(file, value);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Grayscales the image in place.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void pbmImage::grayscale()
+{
+    ::grayscale(file);
+    isGray = true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Stretches the contrast of the image in place, which also grays it.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void pbmImage::contrast()
+{
+    ::contrast(file);
+    isGray = true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Sharpens the image in place.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool pbmImage::sharpen()
+{
+    return ::sharpen(file);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Smooths the image in place.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool pbmImage::smooth()
+{
+    return ::smooth(file);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Replaces the image with its edges, which also grays it.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool pbmImage::edges()
+{
+    if (!sobel(file, isGray))
+        return false;
+    isGray = true;
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Turns the image black and white against the mean of the window around
+ * each pixel, which also grays it.
+ *
+ * @param[in] radius - pixels the window reaches out from the center, at
+ *                    least 1.
+ *
+ * @returns true - image thresholded
+ * @returns false - radius less than 1, or memory allocation failed
+ *
+ ******************************************************************************/
+bool pbmImage::adaptiveThreshold(int radius)
+{
+    if (radius < 1 || !::adaptiveThreshold(file, radius, isGray))
+        return false;
+    isGray = true;
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Evens out the contrast of the image in place, window by window.
+ *
+ * @param[in] radius - pixels the window reaches out from the center, at
+ *                    least 1.
+ *
+ * @returns true - contrast evened out
+ * @returns false - radius less than 1, or memory allocation failed
+ *
+ ******************************************************************************/
+bool pbmImage::localContrast(int radius)
+{
+    if (radius < 1)
+        return false;
+    return ::localContrast(file, radius, isGray);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Shrinks the image in place to fit inside the given size.
+ *
+ * @param[in] cols - widest the thumbnail may be, at least 1.
+ * @param[in] rows - tallest the thumbnail may be, at least 1.
+ *
+ * @returns true - image shrunk
+ * @returns false - size less than 1, or memory allocation failed
+ *
+ ******************************************************************************/
+bool pbmImage::thumbnail(int cols, int rows)
+{
+    if (cols < 1 || rows < 1)
+        return false;
+    return ::thumbnail(file, cols, rows);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Rotates the image clockwise in place.
+ *
+ * @param[in] degrees - 90, 180 or 270.
+ *
+ * @returns true - image rotated
+ * @returns false - degrees not 90, 180 or 270, or memory allocation failed
+ *
+ ******************************************************************************/
+bool pbmImage::rotate(int degrees)
+{
+    if (degrees != 90 && degrees != 180 && degrees != 270)
+        return false;
+    return ::rotate(file, degrees);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Mirrors the image left to right in place.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void pbmImage::flipHorizontal()
+{
+    ::flipHorizontal(file);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Mirrors the image top to bottom in place.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void pbmImage::flipVertical()
+{
+    ::flipVertical(file);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Transposes the image in place.
+ *
+ * @returns true - memory allocated
+ * @returns false - memory allocation failed
+ *
+ ******************************************************************************/
+bool pbmImage::transpose()
+{
+    return ::transpose(file);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns a negated image. Pass the image with move() to reuse its planes,
+ * or clone() to keep the original. The other functions below work the same.
+ *
+ * @param[in] img - image to negate.
+ *
+ * @returns the negated image
+ *
+ ******************************************************************************/
+pbmImage negated(pbmImage img)
+{
+    img.negate();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns a brightened image.
+ *
+ * @param[in] img - image to brighten.
+ * @param[in] value - amount to add to every pixel, may be negative.
+ *
+ * @returns the brightened image
+ *
+ ******************************************************************************/
+pbmImage brightened(pbmImage img, int value)
+{
+    img.brighten(value);
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns a grayscaled image.
+ *
+ * @param[in] img - image to gray.
+ *
+ * @returns the gray image
+ *
+ ******************************************************************************/
+pbmImage grayscaled(pbmImage img)
+{
+    img.grayscale();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns an image with its contrast stretched.
+ *
+ * @param[in] img - image to stretch.
+ *
+ * @returns the gray, stretched image
+ *
+ ******************************************************************************/
+pbmImage contrasted(pbmImage img)
+{
+    img.contrast();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns a sharpened image.
+ *
+ * @param[in] img - image to sharpen.
+ *
+ * @returns the sharpened image, empty if memory ran out
+ *
+ ******************************************************************************/
+pbmImage sharpened(pbmImage img)
+{
+    if (!img.sharpen())
+        img.release();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns a smoothed image.
+ *
+ * @param[in] img - image to smooth.
+ *
+ * @returns the smoothed image, empty if memory ran out
+ *
+ ******************************************************************************/
+pbmImage smoothed(pbmImage img)
+{
+    if (!img.smooth())
+        img.release();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns the edges of an image.
+ *
+ * @param[in] img - image to find the edges of.
+ *
+ * @returns the gray edge image, empty if memory ran out
+ *
+ ******************************************************************************/
+pbmImage edgesOf(pbmImage img)
+{
+    if (!img.edges())
+        img.release();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns an image turned black and white by adaptive threshold.
+ *
+ * @param[in] img - image to threshold.
+ * @param[in] radius - pixels the window reaches out from the center, at
+ *                    least 1.
+ *
+ * @returns the gray thresholded image, empty if the radius is less than 1
+ *          or memory ran out
+ *
+ ******************************************************************************/
+pbmImage thresholded(pbmImage img, int radius)
+{
+    if (!img.adaptiveThreshold(radius))
+        img.release();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns an image with its local contrast evened out.
+ *
+ * @param[in] img - image to process.
+ * @param[in] radius - pixels the window reaches out from the center, at
+ *                    least 1.
+ *
+ * @returns the processed image, empty if the radius is less than 1 or
+ *          memory ran out
+ *
+ ******************************************************************************/
+pbmImage localContrasted(pbmImage img, int radius)
+{
+    if (!img.localContrast(radius))
+        img.release();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns a thumbnail of an image.
+ *
+ * @param[in] img - image to shrink.
+ * @param[in] cols - widest the thumbnail may be, at least 1.
+ * @param[in] rows - tallest the thumbnail may be, at least 1.
+ *
+ * @returns the thumbnail, empty if the size is less than 1 or memory ran
+ *          out
+ *
+ ******************************************************************************/
+pbmImage thumbnailed(pbmImage img, int cols, int rows)
+{
+    if (!img.thumbnail(cols, rows))
+        img.release();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns an image rotated clockwise.
+ *
+ * @param[in] img - image to rotate.
+ * @param[in] degrees - 90, 180 or 270.
+ *
+ * @returns the rotated image, empty if the degrees are not 90, 180 or 270
+ *          or memory ran out
+ *
+ ******************************************************************************/
+pbmImage rotated(pbmImage img, int degrees)
+{
+    if (!img.rotate(degrees))
+        img.release();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns an image mirrored left to right.
+ *
+ * @param[in] img - image to mirror.
+ *
+ * @returns the mirrored image
+ *
+ ******************************************************************************/
+pbmImage flippedHorizontal(pbmImage img)
+{
+    img.flipHorizontal();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns an image mirrored top to bottom.
+ *
+ * @param[in] img - image to mirror.
+ *
+ * @returns the mirrored image
+ *
+ ******************************************************************************/
+pbmImage flippedVertical(pbmImage img)
+{
+    img.flipVertical();
+    return img;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Returns a transposed image.
+ *
+ * @param[in] img - image to transpose.
+ *
+ * @returns the transposed image, empty if memory ran out
+ *
+ ******************************************************************************/
+pbmImage transposed(pbmImage img)
+{
+    if (!img.transpose())
+        img.release();
+    return img;
+}
@@ -0,0 +1,92 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Library interface for using the image code from other programs
+ *
+ * pbmImage owns its planes and frees them when it goes away. It can be
+ * moved but not copied, clone() makes a copy when one is really wanted.
+ * Every operation can be run in place through a member function, or through
+ * the free function of the same idea, which takes the image by value and
+ * returns the result. Moving an image into one of those hands its planes
+ * straight through without copying them:
+ *
+   @verbatim
+   pbmImage img = pbmImage::decodeFile("in.ppm");
+   pbmImage small = thumbnailed(std::move(img), 160, 120);
+   std::string bytes = small.encodeMemory(true);
+   @endverbatim
+ *
+ * Only the standard library and imageTypes.h are included, so nothing here
+ * adds names to the program that uses it.
+ ******************************************************************************/
+#include <cstddef>
+#include <string>
+#include "imageTypes.h"
+
+#ifndef __NETPBMLIB__H__
+#define __NETPBMLIB__H__
+
+/*!
+ * @brief An image that owns its pixel planes
+ */
+class pbmImage
+{
+public:
+    pbmImage();
+    pbmImage(int rows, int cols);
+    ~pbmImage();
+    pbmImage(pbmImage &&other) noexcept;
+    pbmImage &operator=(pbmImage &&other) noexcept;
+    pbmImage(const pbmImage &) = delete;
+    pbmImage &operator=(const pbmImage &) = delete;
+
+    static pbmImage decodeFile(const std::string &path);
+    static pbmImage decodeMemory(const char *data, std::size_t size);
+    bool encodeFile(const std::string &outname, bool binary);
+    std::string encodeMemory(bool binary);
+
+    pbmImage clone() const;
+    void release();
+    bool empty() const;
+    int rows() const;
+    int cols() const;
+    bool gray() const;
+    pixel *plane(int color);
+    const pixel *plane(int color) const;
+    image &raw();
+
+    void negate();
+    void brighten(int value);
+    void grayscale();
+    void contrast();
+    bool sharpen();
+    bool smooth();
+    bool edges();
+    bool adaptiveThreshold(int radius);
+    bool localContrast(int radius);
+    bool thumbnail(int cols, int rows);
+    bool rotate(int degrees);
+    void flipHorizontal();
+    void flipVertical();
+    bool transpose();
+
+private:
+    image file;             /*!< The planes and header this object owns*/
+    bool isGray = false;    /*!< Only redgray holds the image*/
+};
+
+pbmImage negated(pbmImage img);
+pbmImage brightened(pbmImage img, int value);
+pbmImage grayscaled(pbmImage img);
+pbmImage contrasted(pbmImage img);
+pbmImage sharpened(pbmImage img);
+pbmImage smoothed(pbmImage img);
+pbmImage edgesOf(pbmImage img);
+pbmImage thresholded(pbmImage img, int radius);
+pbmImage localContrasted(pbmImage img, int radius);
+pbmImage thumbnailed(pbmImage img, int cols, int rows);
+pbmImage rotated(pbmImage img, int degrees);
+pbmImage flippedHorizontal(pbmImage img);
+pbmImage flippedVertical(pbmImage img);
+pbmImage transposed(pbmImage img);
+#endif
@@ -0,0 +1,336 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Times each stage of a run and counts bytes and allocations
+ *
+ * Every function here returns straight away unless profiling was turned on
+ * with --profile or --trace, so the calls can stay in the normal code.
+ ******************************************************************************/
+#include "netPBM.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+/*!
+ * @brief Times of one stage of the run
+ */
+struct profileStage
+{
+    string name;        /*!< Name of the stage*/
+    double wallStart;   /*!< Wall clock microseconds when the stage began*/
+    double wallEnd;     /*!< Wall clock microseconds when the stage ended*/
+    double cpuStart;    /*!< Process CPU microseconds when the stage began*/
+    double cpuEnd;      /*!< Process CPU microseconds when the stage ended*/
+};
+
+static bool enabled = false;             /*!< True once profiling is on*/
+static string tracePath;                 /*!< Chrome trace file, if any*/
+static vector<profileStage> stages;      /*!< Stages in the order begun*/
+static atomic<long long> bytesRead(0);   /*!< Bytes read from files*/
+static atomic<long long> bytesWritten(0);/*!< Bytes written to files*/
+static atomic<long long> allocations(0); /*!< Calls to alloc2d*/
+static atomic<long long> allocBytes(0);  /*!< Bytes asked of alloc2d*/
+static atomic<long long> reused(0);      /*!< Calls served from the pool*/
+static chrono::steady_clock::time_point startTime; /*!< When profiling began*/
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the CPU time used by every thread of the process so far.
+ *
+ * @returns CPU time in microseconds
+ *
+ ******************************************************************************/
+double processCpuMicros()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    ULARGE_INTEGER k, u;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 10.0; //100 ns units
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 +
+        usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the most memory the process has had in RAM at once.
+ *
+ * @returns peak resident size in kilobytes
+ *
+ ******************************************************************************/
+long long peakResidentKB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return (long long)(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; //bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Turns profiling on for the rest of the run.
+ *
+ * @param[in] trace - file to write Chrome trace events to, or empty.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void profileStart(string trace)
+{
+    enabled = true;
+    tracePath = trace;
+    startTime = chrono::steady_clock::now();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Marks the start of a stage.
+ *
+ * @param[in] name - name of the stage.
+ *
+ * @returns number to hand to profileEnd, -1 if profiling is off
+ *
+ ******************************************************************************/
+int profileBegin(const string &name)
+{
+    profileStage stage;
+    if (!enabled)
+        return -1;
+    stage.name = name;
+    stage.cpuStart = stage.cpuEnd = processCpuMicros();
+    stage.wallStart = stage.wallEnd = chrono::duration<double, micro>(
+        chrono::steady_clock::now() - startTime).count();
+    stages.push_back(stage);
+    return (int)stages.size() - 1;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Marks the end of a stage.
+ *
+ * @param[in] stage - number returned by profileBegin.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void profileEnd(int stage)
+{
+    if (stage < 0)
+        return;
+    stages[stage].wallEnd = chrono::duration<double, micro>(
+        chrono::steady_clock::now() - startTime).count();
+    stages[stage].cpuEnd = processCpuMicros();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Marks the start of a stage that ends when the scope is left.
+ *
+ * @param[in] name - what the stage is called in the report.
+ *
+ ******************************************************************************/
+profileScope::profileScope(const string &name) : stage(profileBegin(name))
+{
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Marks the end of the stage, unless it was already ended.
+ *
+ ******************************************************************************/
+profileScope::~profileScope()
+{
+    end();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Marks the end of the stage before the scope is left.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void profileScope::end()
+{
+    profileEnd(stage);
+    stage = -1;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Counts bytes read from or written to files.
+ *
+ * @param[in] read - bytes read.
+ * @param[in] written - bytes written.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void profileBytes(long long read, long long written)
+{
+    if (!enabled)
+        return;
+    bytesRead += read;
+    bytesWritten += written;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Counts one allocation of image memory.
+ *
+ * @param[in] bytes - size of the allocation.
+ * @param[in] pooled - true if it was a chunk reused from the pool.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void profileAlloc(long long bytes, bool pooled)
+{
+    if (!enabled)
+        return;
+    allocations++;
+    allocBytes += bytes;
+    if (pooled)
+        reused++;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes a string as a quoted JSON string.
+ *
+ * @param[in] out - where to write.
+ * @param[in] text - string to write.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void writeJsonString(ostream &out, const string &text)
+{
+    size_t k;
+    char code[8];
+    out << '"';
+    for (k = 0; k < text.size(); k++)
+    {
+        if (text[k] == '"' || text[k] == '\\')
+            out << '\\' << text[k];
+        else if ((unsigned char)text[k] < 0x20)
+        {
+            snprintf(code, sizeof(code), "\\u%04x", text[k]);
+            out << code;
+        }
+        else
+            out << text[k];
+    }
+    out << '"';
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes the JSON summary of the run to the screen, and the Chrome trace
+ * events to the trace file if one was given. The trace can be opened in
+ * chrome://tracing or Perfetto to see the stages on a timeline.
+ *
+ * @param[in] exitCode - what the run is about to return.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void profileReport(int exitCode)
+{
+    size_t k;
+    ofstream trace;
+    if (!enabled)
+        return;
+
+    cout << "{\n  \"exit_code\": " << exitCode << ",\n  \"wall_ms\": "
+        << chrono::duration<double, milli>(chrono::steady_clock::now() -
+        startTime).count() << ",\n  \"cpu_ms\": " << processCpuMicros() / 1000
+        << ",\n  \"threads\": " << getThreadCount()
+        << ",\n  \"bytes_read\": " << bytesRead
+        << ",\n  \"bytes_written\": " << bytesWritten
+        << ",\n  \"allocations\": " << allocations
+        << ",\n  \"allocated_bytes\": " << allocBytes
+        << ",\n  \"pool_reused\": " << reused
+        << ",\n  \"peak_rss_kb\": " << peakResidentKB()
+        << ",\n  \"stages\": [";
+    for (k = 0; k < stages.size(); k++)
+    {
+        cout << (k == 0 ? "\n    { \"name\": " : ",\n    { \"name\": ");
+        writeJsonString(cout, stages[k].name);
+        cout << ", \"wall_ms\": " << (stages[k].wallEnd -
+            stages[k].wallStart) / 1000 << ", \"cpu_ms\": "
+            << (stages[k].cpuEnd - stages[k].cpuStart) / 1000 << " }";
+    }
+    cout << "\n  ]\n}" << endl;
+
+    if (tracePath.size() == 0)
+        return;
+    trace.open(tracePath);
+    if (!trace)
+    {
+        cout << "File could not open." << endl;
+        return;
+    }
+    trace << "{\"traceEvents\":[";
+    for (k = 0; k < stages.size(); k++)
+    {
+        trace << (k == 0 ? "\n" : ",\n") << "{\"name\":";
+        writeJsonString(trace, stages[k].name);
+        trace << ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+            << (long long)stages[k].wallStart << ",\"dur\":"
+            << (long long)(stages[k].wallEnd - stages[k].wallStart)
+            << ",\"args\":{\"cpu_us\":" << (long long)(stages[k].cpuEnd -
+            stages[k].cpuStart) << "}}";
+    }
+    trace << "\n]}\n";
+}
@@ -4,43 +4,86 @@
  * @brief 'main' function (controls flow of program)
  ******************************************************************************/
 #include "netPBM.h"
+#include "netpbmlib.h"
 /***************************************************************************//**
  * @author Dillon Roller
  *
  * @par Description:
- * This is the starting point to the program.  It will get the command 
- * arguments from the user, input image file contents and call functions 
- * corresponding to those chosen by the user. 
+ * Runs one command line.  It will get the command arguments from the user,
+ * input image file contents and call functions corresponding to those
+ * chosen by the user. 
  *
  * @param[in] argc - the number of arguments from the command prompt.
  * @param[in] argv - a 2d array of characters containing the arguments.
+ * @param[out] outputs - names of the files written with -oa, -ob, -oc or -ot.
  *
  * @returns 1 - failed to open file
  * @returns 2 - failed to allocated memory
  * @returns 3 - invalid command line
  *
  ******************************************************************************/
-int main(int argc, char **argv) {
-    image inFile; //variables
+int processImage(int argc, char **argv, vector<string> &outputs) {
+    pbmImage owner; //frees the planes on every way out
+    image &inFile = owner.raw(); //variables
     string outname;
     ifstream fin;
     ofstream fout;
     int i;
+    int cols, rows;
     bool gray = false;
     if (argc == 1) {
-        cout << "Usage - prog1.exe [option] -o[a or b] outputname"
+        cout << "Usage - prog1.exe [option] -o[a, b, c or t] outputname"
             << "inputname.ppm\nEnding program..." << endl;
         return 1;
     }
+    if (string(argv[1]) == "--bench") //time everything, no image needed
+        return runBenchmarks(argc > 2 ? argv[2] : "") ? 0 : 1;
+    if (string(argv[1]) == "--verify") //check against original versions
+        return runVerify() ? 0 : 1;
 
     inFile.name = argv[argc - 1];
     outname = argv[argc - 2];
+    profileScope header("read header");
     if (!readHeaderInfo(fin, inFile)) //ends if couldnt read file
+    {
+        if (fin.is_open())
+            cout << "Invalid magic number" << endl;
+        else
+            cout << "File could not open." << endl;
         return 1;
+    }
+    header.end();
+    //a thumbnail as the first option is done while decoding
+    rows = inFile.rows;
+    cols = inFile.cols;
+    if (argc > 4 && string(argv[1]) == "-t")
+    {
+        if (!getThumbSize(argv[2], cols, rows))
+        {
+            cout << "Invalid thumbnail size: " << argv[2] << endl;
+            return 3;
+        }
+        rows = min(rows, inFile.rows);
+        cols = min(cols, inFile.cols);
+        inFile.thumbRows = rows;
+        inFile.thumbCols = cols;
+    }
+    //a region has to be first so only its pixels are read and processed
+    if (argc > 4 && string(argv[1]) == "-r")
+    {
+        if (!getRegion(argv[2], inFile))
+        {
+            cout << "Invalid region: " << argv[2] << endl;
+            return 3;
+        }
+        rows = inFile.roiRows;
+        cols = inFile.roiCols;
+    }
     //if allocation fails for any array, free up memory and end
-    if (!alloc2d(inFile.redgray, inFile.rows, inFile.cols) || 
-        !alloc2d(inFile.green, inFile.rows, inFile.cols) ||
-        !alloc2d(inFile.blue, inFile.rows, inFile.cols)) 
+    profileScope decode("decode");
+    if (!alloc2d(inFile.redgray, rows, cols) || 
+        !alloc2d(inFile.green, rows, cols) ||
+        !alloc2d(inFile.blue, rows, cols)) 
     {
         cout << "Memory error" << endl;
         return 2;
@@ -49,16 +92,42 @@ int main(int argc, char **argv) {
         readBinaryRGB(fin, inFile);
     if (inFile.header == "P3")
         readAsciiRGB(fin, inFile);
-    if (argc < 4 || argc > 6) {//error check number of arguments
+    if (inFile.header == "PZ" && !readCompressed(fin, inFile))
+        cout << "Invalid container" << endl;
+    if (inFile.header == "PT" && !readTiled(fin, inFile))
+        cout << "Invalid tiled image" << endl;
+    decode.end();
+    if (argc < 4) {//error check number of arguments
         cout << "Not enough arguments...Ending program" << endl;
         return 3;
     }
     for (i = 1; i < argc - 2; i++) { //loop through command arguments
+        profileScope stage(argv[i]); //ended on every way out
         if (argv[i][0] == '-' && argv[i][1] == 'o'){
+            if (argv[i][2] == 'a' || argv[i][2] == 'b')
+                outputs.push_back(outname + (gray ? ".pgm" : ".ppm"));
+            if (argv[i][2] == 'c')
+                outputs.push_back(outname + ".pzc");
+            if (argv[i][2] == 't')
+                outputs.push_back(outname + ".ptl");
             if (argv[i][2] == 'a')
                 writeAscii(fout, inFile, outname, gray); //write ascii
             else if (argv[i][2] == 'b')
                 writeBinary(fout, inFile, outname, gray);//write binary
+            else if (argv[i][2] == 'c')//write compressed container
+                writeCompressed(fout, inFile, outname, gray);
+            else if (argv[i][2] == 't')//write tiled
+                writeTiled(fout, inFile, outname, gray);
+            else if (argv[i][2] == 'p') {//patch region into binary image
+                if (!writePatch(inFile, outname, gray)) {
+                    if (canPatch(inFile))
+                        cout << "File could not open." << endl;
+                    else
+                        cout << "Patching needs an unresized region of a "
+                            "binary image" << endl;
+                    return 1;
+                }
+            }
             else {
                 cout << "Invalid operation: " << argv[i][1] << argv[i][2]
                     << endl;
@@ -66,7 +135,7 @@ int main(int argc, char **argv) {
             }
         } 
         else if (argv[i][1] == 'n')//negate
-            negate(inFile);
+            ::negate(inFile);
         else if (argv[i][1] == 'b') {//brighten
             brighten(inFile, stoi(argv[i + 1]));
             i++;
@@ -80,9 +149,68 @@ int main(int argc, char **argv) {
                 return 2;
             }
         else if (argv[i][1] == 'g') {//grayscale
-            grayscale(inFile);
+            if (i + 1 < argc - 2 && string(argv[i + 1]) == "-e") {
+                if (!sobel(inFile, false))//gray while finding edges
+                    return 2;
+                i++;
+            }
+            else
+                grayscale(inFile);
+            gray = true;
+        }
+        else if (argv[i][1] == 'e') {//edges
+            if (!sobel(inFile, gray))
+                return 2;
             gray = true;
         }
+        else if (argv[i][1] == 'a' || argv[i][1] == 'l') {//windowed ops
+            if (i + 1 >= argc - 2 || atoi(argv[i + 1]) < 1) {
+                cout << "Window radius must be 1 or more" << endl;
+                return 3;
+            }
+            if (argv[i][1] == 'a' &&
+                !adaptiveThreshold(inFile, atoi(argv[i + 1]), gray))
+                return 2;
+            if (argv[i][1] == 'l' &&
+                !localContrast(inFile, atoi(argv[i + 1]), gray))
+                return 2;
+            gray = gray || argv[i][1] == 'a';
+            i++;
+        }
+        else if (argv[i][1] == 't') {//thumbnail
+            if (i + 1 >= argc - 2 || !getThumbSize(argv[i + 1], cols, rows)) {
+                cout << "Invalid thumbnail size" << endl;
+                return 3;
+            }
+            if (i != 1 && !thumbnail(inFile, cols, rows))//first is done
+                return 2;
+            i++;
+        }
+        else if (argv[i][1] == 'r') {//region, already read
+            if (i != 1) {
+                cout << "Region must be the first option" << endl;
+                return 3;
+            }
+            i++;
+        }
+        else if (argv[i][1] == 'R') {//rotate
+            if (i + 1 >= argc - 2 || (string(argv[i + 1]) != "90" &&
+                string(argv[i + 1]) != "180" && string(argv[i + 1]) != "270")) {
+                cout << "Rotation must be 90, 180 or 270" << endl;
+                return 3;
+            }
+            if (!rotate(inFile, stoi(argv[i + 1])))
+                return 2;
+            i++;
+        }
+        else if (argv[i][1] == 'f' && argv[i][2] == 'h')//flip horizontal
+            flipHorizontal(inFile);
+        else if (argv[i][1] == 'f' && argv[i][2] == 'v')//flip vertical
+            flipVertical(inFile);
+        else if (argv[i][1] == 'x') {//transpose
+            if (!transpose(inFile))
+                return 2;
+        }
         else if (argv[i][1] == 'c'){//contrast
             contrast(inFile);
             gray = true;
@@ -93,4 +221,69 @@ int main(int argc, char **argv) {
         }
     }
     return 0;
-}
\ No newline at end of file
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * This is the starting point to the program.  It takes off the profiling,
+ * memory and cache options if they come first, runs the rest of the command
+ * line, through the cache if one was given, and then reports the profile of
+ * the run.
+ *
+ * @param[in] argc - the number of arguments from the command prompt.
+ * @param[in] argv - a 2d array of characters containing the arguments.
+ *
+ * @returns 1 - failed to open file
+ * @returns 2 - failed to allocated memory
+ * @returns 3 - invalid command line
+ *
+ ******************************************************************************/
+int main(int argc, char **argv) {
+    string trace, cacheDir;
+    long long cacheLimit = CACHE_DEFAULT_MB;
+    bool profile = false;
+    int code;
+    char *end;
+    vector<string> outputs;
+    while (argc > 1) { //argv[0] is never used, so options can be skipped
+        if (string(argv[1]) == "--hugepages")
+            setHugePages(true);
+        else if (string(argv[1]) == "--profile")
+            profile = true;
+        else if (argc > 2 && string(argv[1]) == "--trace") {
+            profile = true;
+            trace = argv[2];
+            argv++;
+            argc--;
+        }
+        else if (argc > 2 && string(argv[1]) == "--cache") {
+            cacheDir = argv[2];
+            argv++;
+            argc--;
+        }
+        else if (argc > 2 && string(argv[1]) == "--cache-size") {
+            cacheLimit = strtol(argv[2], &end, 10);
+            if (end == argv[2] || *end != '\0' || cacheLimit < 0) {
+                cout << "Invalid cache size: " << argv[2] << endl;
+                return 3;
+            }
+            argv++;
+            argc--;
+        }
+        else
+            break;
+        argv++;
+        argc--;
+    }
+    if (profile)
+        profileStart(trace);
+    if (cacheDir.size() != 0)
+        code = cachedRun(cacheDir, cacheLimit << 20, argc, argv,
+            processImage);
+    else
+        code = processImage(argc, argv, outputs);
+    profileReport(code);
+    return code;
+}
@@ -0,0 +1,90 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Splits row loops of the image operations across threads
+ ******************************************************************************/
+#include "netPBM.h"
+#include <thread>
+
+/*!
+ * @brief Number of threads to use, 0 means one per hardware thread
+ */
+static int threadCount = 0;
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Sets how many threads the row loops are split across.
+ *
+ * @param[in] count - number of threads, 0 to use every hardware thread.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void setThreadCount(int count)
+{
+    threadCount = count > 0 ? count : 0;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets how many threads the row loops are split across.
+ *
+ * @returns the thread count, at least 1
+ *
+ ******************************************************************************/
+int getThreadCount()
+{
+    unsigned hardware;
+    if (threadCount > 0)
+        return threadCount;
+    hardware = thread::hardware_concurrency();
+    return hardware > 0 ? (int)hardware : 1;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Runs work over the rows first up to last, split into one band of rows per
+ * thread. Each band is handed to work as its own first and last row, so work
+ * must only write rows inside the band it is given. Returns once every band
+ * is done. The same split works for anything numbered, such as blocks of
+ * rows, by giving a smaller minimum band.
+ *
+ * @param[in] first - first row to process.
+ * @param[in] last - one past the last row to process.
+ * @param[in] work - function that processes the rows [first, last).
+ * @param[in] minBand - fewest rows worth giving to one thread.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void parallelRows(int first, int last, const function<void(int, int)> &work,
+    int minBand)
+{
+    int k, bands, start, end;
+    vector<thread> workers;
+
+    if (last <= first)
+        return;
+    bands = min(getThreadCount(), (last - first + minBand - 1) / minBand);
+    if (bands <= 1)
+    {
+        work(first, last);
+        return;
+    }
+
+    for (k = 1; k < bands; k++) //this thread does the first band itself
+    {
+        start = first + (int)((long long)(last - first) * k / bands);
+        end = first + (int)((long long)(last - first) * (k + 1) / bands);
+        workers.push_back(thread(work, start, end));
+    }
+    work(first, first + (int)((long long)(last - first) / bands));
+    for (k = 0; k < (int)workers.size(); k++)
+        workers[k].join();
+}
@@ -0,0 +1,629 @@
+/***************************************************************************//**
+ * @file
+ *
+ * @brief Checks the optimized operations against the original versions
+ *
+ * The ref functions below are the original one pixel at a time versions of
+ * the operations, kept as they were, quirks included (smooth divides its
+ * eight neighbours by 9.0, contrast rounds its scale before using it). The
+ * optimized versions must give exactly the same pixels.
+ ******************************************************************************/
+#include "netPBM.h"
+#include <cstring>
+#include <sstream>
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Original negate.
+ *
+ * @param[in,out] file - image to negate.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void refNegate(image &file)
+{
+    int i, j;
+    for (i = 0; i < file.rows; i++)
+        for (j = 0; j < file.cols; j++)
+        {
+            file.redgray[i][j] = 255 - file.redgray[i][j];
+            file.green[i][j] = 255 - file.green[i][j];
+            file.blue[i][j] = 255 - file.blue[i][j];
+        }
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Original grayscale.
+ *
+ * @param[in,out] file - image to gray.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void refGrayscale(image &file)
+{
+    int i, j;
+    for (i = 0; i < file.rows; i++)
+        for (j = 0; j < file.cols; j++)
+        {
+            file.redgray[i][j] = (pixel)(.3 * (int)file.redgray[i][j] +
+                .6 * (int)file.green[i][j] + .1 * (int)file.blue[i][j]);
+        }
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Original brighten.
+ *
+ * @param[in,out] file - image to brighten.
+ * @param[in] value - value to be added to each pixel
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void refBrighten(image &file, int value)
+{
+    int i, j, k;
+    pixel **planes[3] = { file.redgray, file.green, file.blue };
+    for (k = 0; k < 3; k++)
+        for (i = 0; i < file.rows; i++)
+            for (j = 0; j < file.cols; j++)
+            {
+                if ((int)planes[k][i][j] + value > 255)
+                    planes[k][i][j] = (pixel)255;
+                else if ((int)planes[k][i][j] + value < 0)
+                    planes[k][i][j] = (pixel)0;
+                else
+                    planes[k][i][j] += (pixel)value;
+            }
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Original contrast, including rounding the scale before it is used.
+ *
+ * @param[in,out] file - image to contrast.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void refContrast(image &file)
+{
+    int i, j;
+    int min, max;
+    double scale;
+
+    refGrayscale(file);
+    min = max = file.redgray[0][0];
+    for (i = 0; i < file.rows; i++)
+        for (j = 0; j < file.cols; j++)
+        {
+            if (file.redgray[i][j] < min)
+                min = file.redgray[i][j];
+            if (file.redgray[i][j] > max)
+                max = file.redgray[i][j];
+        }
+
+    scale = 255.0 / (double)(max - min);
+    scale = floor(scale + 0.5);
+    for (i = 0; i < file.rows; i++)
+        for (j = 0; j < file.cols; j++)
+            file.redgray[i][j] = (int)scale * (file.redgray[i][j] - min);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Original 3x3 filters. Sharpen is 5 times the pixel minus its four side
+ * neighbours, clamped. Smooth is the eight neighbours over 9.0, rounded.
+ * Border pixels become 0.
+ *
+ * @param[in,out] file - image to filter.
+ * @param[in] sharp - true to sharpen, false to smooth.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void refFilter(image &file, bool sharp)
+{
+    int i, j, k, value;
+    double sum;
+    vector<pixel> out((size_t)file.rows * file.cols);
+    pixel **planes[3] = { file.redgray, file.green, file.blue };
+
+    for (k = 0; k < 3; k++)
+    {
+        pixel **p = planes[k];
+        fill(out.begin(), out.end(), (pixel)0);
+        for (i = 1; i < file.rows - 1; i++)
+            for (j = 1; j < file.cols - 1; j++)
+            {
+                if (sharp)
+                {
+                    value = 5 * p[i][j] - p[i][j - 1] - p[i + 1][j] -
+                        p[i][j + 1] - p[i - 1][j];
+                    value = value > 255 ? 255 : (value < 0 ? 0 : value);
+                }
+                else
+                {
+                    sum = ((double)p[i - 1][j - 1] + p[i - 1][j] +
+                        p[i - 1][j + 1] + p[i][j + 1] + p[i + 1][j + 1] +
+                        p[i + 1][j] + p[i + 1][j - 1] + p[i][j - 1]) / 9.0;
+                    value = (int)(sum + 0.5);
+                }
+                out[(size_t)i * file.cols + j] = (pixel)value;
+            }
+        for (i = 0; i < file.rows; i++)
+            for (j = 0; j < file.cols; j++)
+                p[i][j] = out[(size_t)i * file.cols + j];
+    }
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Plain Sobel edges of the grayscaled image, one pixel at a time.
+ *
+ * @param[in,out] file - image to find edges in, red holds the result.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void refSobel(image &file)
+{
+    int i, j, gx, gy;
+    vector<pixel> out((size_t)file.rows * file.cols, 0);
+    pixel **p;
+
+    refGrayscale(file);
+    p = file.redgray;
+    for (i = 1; i < file.rows - 1; i++)
+        for (j = 1; j < file.cols - 1; j++)
+        {
+            gx = p[i - 1][j + 1] + 2 * p[i][j + 1] + p[i + 1][j + 1] -
+                p[i - 1][j - 1] - 2 * p[i][j - 1] - p[i + 1][j - 1];
+            gy = p[i + 1][j - 1] + 2 * p[i + 1][j] + p[i + 1][j + 1] -
+                p[i - 1][j - 1] - 2 * p[i - 1][j] - p[i - 1][j + 1];
+            out[(size_t)i * file.cols + j] = (pixel)min(255, abs(gx) + abs(gy));
+        }
+    for (i = 0; i < file.rows; i++)
+        for (j = 0; j < file.cols; j++)
+            p[i][j] = out[(size_t)i * file.cols + j];
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adaptive threshold or local contrast with every window summed pixel by
+ * pixel, to check the integral image sums against.
+ *
+ * @param[in,out] file - image to process, arrays are replaced.
+ * @param[in] radius - pixels the window reaches out from the center.
+ * @param[in] threshold - true for adaptive threshold, false for local
+ *                        contrast of every color.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void refWindows(image &file, int radius, bool threshold)
+{
+    int i, j, r, c, k;
+    unsigned long long sum, squares, area;
+    vector<pixel> out((size_t)file.rows * file.cols);
+    pixel **planes[3] = { file.redgray, file.green, file.blue };
+    pixel **p;
+
+    if (threshold)
+        refGrayscale(file);
+    for (k = 0; k < (threshold ? 1 : 3); k++)
+    {
+        p = planes[k];
+        for (i = 0; i < file.rows; i++)
+            for (j = 0; j < file.cols; j++)
+            {
+                sum = squares = area = 0;
+                for (r = max(0, i - radius); r <= i + radius &&
+                    r < file.rows; r++)
+                    for (c = max(0, j - radius); c <= j + radius &&
+                        c < file.cols; c++)
+                    {
+                        sum += p[r][c];
+                        squares += p[r][c] * p[r][c];
+                        area++;
+                    }
+                out[(size_t)i * file.cols + j] = threshold ?
+                    adaptiveValue(p[i][j], sum, area) :
+                    localContrastValue(p[i][j], sum, squares, area);
+            }
+        for (i = 0; i < file.rows; i++)
+            for (j = 0; j < file.cols; j++)
+                p[i][j] = out[(size_t)i * file.cols + j];
+    }
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Plain rotations and flips, moving one pixel at a time by its index.
+ *
+ * @param[in,out] file - image to move, arrays are replaced if size changes.
+ * @param[in] how - 90, 180 or 270 to rotate, 1 horizontal flip, 2 vertical
+ *                  flip, 3 transpose.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void refMove(image &file, int how)
+{
+    int i, j, k, r, c;
+    bool swapped = how == 90 || how == 270 || how == 3;
+    int rows = swapped ? file.cols : file.rows;
+    int cols = swapped ? file.rows : file.cols;
+    pixel **planes[3] = { file.redgray, file.green, file.blue };
+    pixel **moved[3];
+
+    for (k = 0; k < 3; k++)
+    {
+        alloc2d(moved[k], rows, cols);
+        for (i = 0; i < file.rows; i++)
+            for (j = 0; j < file.cols; j++)
+            {
+                r = i;
+                c = j;
+                if (how == 90)
+                {
+                    r = j;
+                    c = file.rows - 1 - i;
+                }
+                else if (how == 270)
+                {
+                    r = file.cols - 1 - j;
+                    c = i;
+                }
+                else if (how == 180)
+                {
+                    r = file.rows - 1 - i;
+                    c = file.cols - 1 - j;
+                }
+                else if (how == 1)
+                    c = file.cols - 1 - j;
+                else if (how == 2)
+                    r = file.rows - 1 - i;
+                else
+                {
+                    r = j;
+                    c = i;
+                }
+                moved[k][r][c] = planes[k][i][j];
+            }
+        free2d(planes[k], file.rows);
+    }
+    file.redgray = moved[0];
+    file.green = moved[1];
+    file.blue = moved[2];
+    file.rows = rows;
+    file.cols = cols;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Plain area averaged thumbnail, averaging each block of source pixels
+ * straight from its bounds.
+ *
+ * @param[in,out] file - image to shrink, arrays are replaced.
+ * @param[in] cols - width of the thumbnail, no more than the image.
+ * @param[in] rows - height of the thumbnail, no more than the image.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void refThumbnail(image &file, int cols, int rows)
+{
+    int ty, tx, y, x, k;
+    unsigned long long sum, area;
+    pixel **planes[3] = { file.redgray, file.green, file.blue };
+    pixel **small[3];
+
+    for (k = 0; k < 3; k++)
+    {
+        alloc2d(small[k], rows, cols);
+        for (ty = 0; ty < rows; ty++)
+            for (tx = 0; tx < cols; tx++)
+            {
+                sum = area = 0;
+                for (y = 0; y < file.rows; y++)
+                    for (x = 0; x < file.cols; x++)
+                        if ((long long)y * rows / file.rows == ty &&
+                            (long long)x * cols / file.cols == tx)
+                        {
+                            sum += planes[k][y][x];
+                            area++;
+                        }
+                small[k][ty][tx] = (pixel)((sum + area / 2) / area);
+            }
+        free2d(planes[k], file.rows);
+    }
+    file.redgray = small[0];
+    file.green = small[1];
+    file.blue = small[2];
+    file.rows = rows;
+    file.cols = cols;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Original ASCII writer, one value at a time through the stream.
+ *
+ * @param[in] file - image to write.
+ * @param[in] gray - write only the gray values.
+ *
+ * @returns the text of the pixel values
+ *
+ ******************************************************************************/
+string refFormatAscii(image &file, bool gray)
+{
+    int i, j;
+    ostringstream out;
+    for (i = 0; i < file.rows; i++)
+        for (j = 0; j < file.cols; j++)
+        {
+            if (gray)
+                out << (int)file.redgray[i][j] << '\n';
+            else
+                out << (int)file.redgray[i][j] << '\n'
+                    << (int)file.green[i][j] << '\n'
+                    << (int)file.blue[i][j] << '\n';
+        }
+    return out.str();
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Fills an image with the same made up pixels as the benchmark, or with a
+ * single value.
+ *
+ * @param[out] file - image to allocate and fill.
+ * @param[in] rows - height of the image.
+ * @param[in] cols - width of the image.
+ * @param[in] value - value for every pixel, or -1 for varied pixels.
+ *
+ * @returns nothing
+ *
+ ******************************************************************************/
+void makeVerifyImage(image &file, int rows, int cols, int value)
+{
+    size_t size = (size_t)rows * cols;
+    makeTestImage(file, rows, cols, (unsigned)(rows * 7919 + cols));
+    if (value < 0)
+        return;
+    memset(file.redgray[0], value, size);
+    memset(file.green[0], value, size);
+    memset(file.blue[0], value, size);
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Compares two images and reports the first pixel that differs.
+ *
+ * @param[in] fast - image from the optimized version.
+ * @param[in] ref - image from the original version.
+ * @param[in] name - what was run, for the report.
+ *
+ * @returns true - images match
+ * @returns false - sizes or pixels differ
+ *
+ ******************************************************************************/
+bool sameImage(image &fast, image &ref, string name)
+{
+    int i, j, k;
+    const char *colors[3] = { "red", "green", "blue" };
+    pixel **a[3] = { fast.redgray, fast.green, fast.blue };
+    pixel **b[3] = { ref.redgray, ref.green, ref.blue };
+
+    if (fast.rows != ref.rows || fast.cols != ref.cols)
+    {
+        cout << "FAIL " << name << ": size " << fast.cols << 'x' << fast.rows
+            << " should be " << ref.cols << 'x' << ref.rows << endl;
+        return false;
+    }
+    for (i = 0; i < ref.rows; i++)
+        for (j = 0; j < ref.cols; j++)
+            for (k = 0; k < 3; k++)
+                if (a[k][i][j] != b[k][i][j])
+                {
+                    cout << "FAIL " << name << ": first difference at row "
+                        << i << " col " << j << ' ' << colors[k] << " = "
+                        << (int)a[k][i][j] << ", should be "
+                        << (int)b[k][i][j] << endl;
+                    return false;
+                }
+    return true;
+}
+
+/***************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Runs every optimized operation and the ASCII reader and writer against the
+ * original versions. Images are varied, all 0 and all 255, in shapes that
+ * include single rows and columns, and each is run with one and with several
+ * threads. Every mismatch is reported with the first pixel that differs.
+ *
+ * @returns true - everything matched
+ * @returns false - at least one mismatch
+ *
+ ******************************************************************************/
+bool runVerify()
+{
+    const int shapes[][2] = { { 1, 1 }, { 1, 40 }, { 40, 1 }, { 2, 2 },
+        { 3, 3 }, { 17, 33 }, { 64, 64 }, { 131, 257 }, { 300, 190 } };
+    const int values[] = { -1, 0, 255 };
+    const int threadCounts[] = { 1, 3, 8 };
+    struct check
+    {
+        string name;
+        function<bool(image &)> fast;
+        function<void(image &)> ref;
+    };
+    vector<check> checks = {
+        { "negate", [](image &f) { ::negate(f); return true; }, refNegate },
+        { "brighten 70", [](image &f) { brighten(f, 70); return true; },
+            [](image &f) { refBrighten(f, 70); } },
+        { "brighten -70", [](image &f) { brighten(f, -70); return true; },
+            [](image &f) { refBrighten(f, -70); } },
+        { "grayscale", [](image &f) { grayscale(f); return true; },
+            refGrayscale },
+        { "contrast", [](image &f) { contrast(f); return true; },
+            refContrast },
+        { "sharpen", sharpen, [](image &f) { refFilter(f, true); } },
+        { "smooth", smooth, [](image &f) { refFilter(f, false); } },
+        { "edges", [](image &f) { return sobel(f, false); }, refSobel },
+        { "gray edges", [](image &f) { grayscale(f); return sobel(f, true); },
+            refSobel },
+        { "adaptive 1", [](image &f) { return adaptiveThreshold(f, 1,
+            false); }, [](image &f) { refWindows(f, 1, true); } },
+        { "adaptive 9", [](image &f) { return adaptiveThreshold(f, 9,
+            false); }, [](image &f) { refWindows(f, 9, true); } },
+        { "local contrast 4", [](image &f) { return localContrast(f, 4,
+            false); }, [](image &f) { refWindows(f, 4, false); } },
+        { "rotate 90", [](image &f) { return rotate(f, 90); },
+            [](image &f) { refMove(f, 90); } },
+        { "rotate 180", [](image &f) { return rotate(f, 180); },
+            [](image &f) { refMove(f, 180); } },
+        { "rotate 270", [](image &f) { return rotate(f, 270); },
+            [](image &f) { refMove(f, 270); } },
+        { "flip h", [](image &f) { flipHorizontal(f); return true; },
+            [](image &f) { refMove(f, 1); } },
+        { "flip v", [](image &f) { flipVertical(f); return true; },
+            [](image &f) { refMove(f, 2); } },
+        { "transpose", transpose, [](image &f) { refMove(f, 3); } },
+        { "thumbnail", [](image &f) { return thumbnail(f, 7, 5); },
+            [](image &f) { refThumbnail(f, min(7, f.cols), min(5, f.rows)); } },
+    };
+    size_t s, v, t, c;
+    int failures = 0, runs = 0;
+    string name, expected;
+    image fast, ref;
+    vector<char> text;
+
+    for (s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+        for (v = 0; v < sizeof(values) / sizeof(values[0]); v++)
+            for (t = 0; t < sizeof(threadCounts) / sizeof(int); t++)
+            {
+                setThreadCount(threadCounts[t]);
+                name = " on " + to_string(shapes[s][1]) + 'x' +
+                    to_string(shapes[s][0]) + (values[v] < 0 ? " varied" :
+                    " all " + to_string(values[v])) + " with " +
+                    to_string(threadCounts[t]) + " threads";
+
+                for (c = 0; c < checks.size(); c++)
+                {
+                    makeVerifyImage(fast, shapes[s][0], shapes[s][1],
+                        values[v]);
+                    makeVerifyImage(ref, shapes[s][0], shapes[s][1],
+                        values[v]);
+                    runs++;
+                    if (!checks[c].fast(fast))
+                    {
+                        cout << "FAIL " << checks[c].name << name
+                            << ": out of memory" << endl;
+                        failures++;
+                    }
+                    else
+                    {
+                        checks[c].ref(ref);
+                        if (!sameImage(fast, ref, checks[c].name + name))
+                            failures++;
+                    }
+                    freeImage(fast);
+                    freeImage(ref);
+                }
+
+                //ascii writer, then the reader on what the writer made
+                makeVerifyImage(fast, shapes[s][0], shapes[s][1], values[v]);
+                makeVerifyImage(ref, shapes[s][0], shapes[s][1], values[v]);
+                expected = refFormatAscii(ref, false);
+                formatAsciiRows(fast, 0, fast.rows, false, text);
+                runs += 2;
+                if (string(text.begin(), text.end()) != expected)
+                {
+                    for (c = 0; c < text.size() && c < expected.size() &&
+                        text[c] == expected[c]; c++)
+                        ;
+                    cout << "FAIL ascii write" << name << ": first difference"
+                        << " at byte " << c << endl;
+                    failures++;
+                }
+                refNegate(fast); //make sure every pixel gets written
+                decodeAsciiBody(expected.data(), expected.size(), fast);
+                if (!sameImage(fast, ref, "ascii read" + name))
+                    failures++;
+
+                //container and tiled writers and readers give back what
+                //went in, color first, then gray
+                for (c = 0; c < 4; c++)
+                {
+                    ostringstream packed(ios::out | ios::binary);
+                    istringstream header;
+                    bool tiled = c >= 2;
+                    if (c == 1 || c == 3) //gray comes back in all colors
+                    {
+                        refGrayscale(ref);
+                        memcpy(ref.green[0], ref.redgray[0],
+                            (size_t)ref.rows * ref.cols);
+                        memcpy(ref.blue[0], ref.redgray[0],
+                            (size_t)ref.rows * ref.cols);
+                    }
+                    if (tiled)
+                        writeTiledStream(packed, ref, c == 3);
+                    else
+                        writeCompressedStream(packed, ref, c == 1);
+                    expected = packed.str();
+                    header.str(expected);
+                    readHeaderStream(header, fast);
+                    refNegate(fast);
+                    runs++;
+                    if (tiled ? !decodeTiledBody(expected.data(),
+                        expected.size(), fast) : !decodeCompressedBody(
+                        expected.data() + fast.dataStart, expected.size() -
+                        fast.dataStart, fast))
+                    {
+                        cout << "FAIL " << (tiled ? "tiled" : "container")
+                            << name << ": bad index" << endl;
+                        failures++;
+                    }
+                    else if (!sameImage(fast, ref, string(c % 2 ? "gray " :
+                        "") + (tiled ? "tiled" : "container") + name))
+                        failures++;
+                }
+                freeImage(fast);
+                freeImage(ref);
+            }
+    setThreadCount(0);
+
+    cout << runs - failures << " of " << runs << " checks match the original"
+        << " versions" << endl;
+    return failures == 0;
+}
@@ -0,0 +1,525 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Makes folder trees of known shapes and times walking them
+ *
+ * A generated tree is deep, wide or a mix of both, with the same files in
+ * every folder, half of them ones the xml lists. The generator moves into
+ * each folder it makes and back out again, so no path it uses gets long and
+ * no folder is held open, however deep the tree is. The benchmark makes
+ * each tree, walks it and writes its xml with one thread and with one per
+ * processor, with the folders already in memory and, where the page cache
+ * can be dropped, with nothing cached, and then removes it again.
+ ****************************************************************************/
+#include "prog3.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+/*!
+ * @brief Each case is repeated until it has run at least this long
+ */
+const double BENCH_MIN_SECONDS = 0.25;
+
+/*!
+ * @brief The shape of a generated tree
+ */
+struct treeShape
+{
+    const char *name;           /*!< Name the shape is asked for by*/
+    int depth;                  /*!< Levels of folders below the top one*/
+    int fanout;                 /*!< Folders inside each folder that has any*/
+    bool spine;                 /*!< Only the first folder inside goes deeper*/
+    int files;                  /*!< Files in every folder, half of them .cpp*/
+};
+
+/*!
+ * @brief The shapes trees can be generated in
+ */
+static const treeShape SHAPES[] = {
+    { "deep", 3000, 2, true, 2 },
+    { "wide", 1, 20000, false, 2 },
+    { "mixed", 6, 5, false, 4 } };
+
+/*!
+ * @brief Where a folder of the tree being made is at
+ */
+struct makeStep
+{
+    int next;                   /*!< Next folder to make inside it*/
+    int count;                  /*!< Folders to make inside it*/
+};
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Makes the current directory another folder.
+ *
+ * @param[in]   path - the folder, full or relative to the current one
+ *
+ * @returns true - directory changed
+ * @returns false - folder could not be entered
+ *
+ ****************************************************************************/
+bool enterFolder( const string &path )
+{
+#ifdef _WIN32
+    return _chdir( path.c_str() ) == 0;
+#else
+    return chdir( path.c_str() ) == 0;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Makes a new folder.
+ *
+ * @param[in]   path - the folder, full or relative to the current one
+ *
+ * @returns true - folder made
+ * @returns false - folder exists or could not be made
+ *
+ ****************************************************************************/
+bool makeFolder( const string &path )
+{
+#ifdef _WIN32
+    return _mkdir( path.c_str() ) == 0;
+#else
+    return mkdir( path.c_str(), 0777 ) == 0;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Removes an empty folder.
+ *
+ * @param[in]   path - the folder, full or relative to the current one
+ *
+ * @returns true - folder removed
+ * @returns false - folder could not be removed
+ *
+ ****************************************************************************/
+bool removeFolder( const string &path )
+{
+#ifdef _WIN32
+    return _rmdir( path.c_str() ) == 0;
+#else
+    return rmdir( path.c_str() ) == 0;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Makes the files of a generated folder in the current directory.
+ *
+ * @param[in]   shape - shape of the tree
+ * @param[in,out] files - files made so far
+ *
+ * @returns true - files made
+ * @returns false - a file could not be made
+ *
+ ****************************************************************************/
+bool makeFiles( const treeShape &shape, long long &files )
+{
+    char name[32];
+    FILE *fout;
+    int k;
+
+    for ( k = 0; k < shape.files; k++ )
+    {
+        snprintf( name, sizeof( name ), "f%d.%s", k, k % 2 ? "txt" : "cpp" );
+        fout = fopen( name, "wb" );
+        if ( fout == NULL )
+            return false;
+        fputs( "// generated\n", fout );
+        if ( fclose( fout ) != 0 )
+            return false;
+        files++;
+    }
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Makes a tree of a shape in a new folder. Each folder is made, entered,
+ * filled and left again in depth first order, with a stack of the folders
+ * still being filled instead of recursion.
+ *
+ * @param[in]   shape - shape of the tree
+ * @param[in]   path - the folder to make it in, which must not exist
+ * @param[out]  folders - folders made, the top one too, so 0 when nothing
+ *                        was made
+ * @param[out]  files - files made
+ *
+ * @returns true - tree made
+ * @returns false - a folder or file could not be made
+ *
+ ****************************************************************************/
+bool makeTree( const treeShape &shape, const string &path, long long &folders,
+    long long &files )
+{
+    vector<makeStep> stack;
+    folder start;
+    char name[32];
+    int index;
+    bool ok;
+
+    folders = files = 0;
+    if ( !openRoot( start, "." ) || !makeFolder( path ) )
+    {
+        closeFolder( start );
+        return false;
+    }
+    ok = enterFolder( path ) && makeFiles( shape, files );
+    folders = 1;
+    stack.push_back( { 0, shape.depth > 0 ? shape.fanout : 0 } );
+    while ( ok && !stack.empty() )
+    {
+        makeStep &top = stack.back();
+        if ( top.next == top.count )
+        {
+            stack.pop_back();
+            ok = stack.empty() || enterFolder( ".." );
+            continue;
+        }
+        index = top.next++;
+        snprintf( name, sizeof( name ), "d%d", index );
+        ok = makeFolder( name ) && enterFolder( name ) &&
+            makeFiles( shape, files );
+        folders++;
+        stack.push_back( { 0, (int)stack.size() >= shape.depth ||
+            ( shape.spine && index != 0 ) ? 0 : shape.fanout } );
+    }
+    ok = enterFolder( start.path ) && ok;
+    closeFolder( start );
+    return ok;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Removes a folder and everything in it. Each folder is entered and listed
+ * once, its files removed and its folders put on a stack, and it is removed
+ * once they are gone.
+ *
+ * @param[in]   path - the folder, full or relative to the current one
+ *
+ * @returns true - folder removed
+ * @returns false - something in it could not be removed
+ *
+ ****************************************************************************/
+bool removeTree( const string &path )
+{
+    vector<pair<string, bool>> stack( 1, make_pair( path, false ) );
+    entryBuffer buffer;
+    folder start, dir;
+    string name;
+    size_t k;
+    bool ok;
+
+    if ( !openRoot( start, "." ) )
+        return false;
+    ok = true;
+    while ( ok && !stack.empty() )
+    {
+        if ( stack.back().second ) //everything in it is gone
+        {
+            name = stack.back().first;
+            stack.pop_back();
+            ok = enterFolder( stack.empty() ? start.path : ".." ) &&
+                removeFolder( name );
+            continue;
+        }
+        stack.back().second = true;
+        ok = enterFolder( stack.back().first ) && openPath( dir, "." ) &&
+            readFolder( dir, buffer );
+        closeFolder( dir );
+        for ( k = 0; k < buffer.used && ok; k++ )
+        {
+            name = buffer.entries[k].name;
+            if ( name == "." || name == ".." )
+                continue;
+            if ( buffer.entries[k].isFolder )
+                stack.push_back( make_pair( name, false ) );
+            else
+                ok = remove( name.c_str() ) == 0;
+        }
+        buffer.used = 0;
+    }
+    ok = enterFolder( start.path ) && ok;
+    closeFolder( start );
+    return ok;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Makes a tree of one of the shapes, to walk or watch like any other.
+ *
+ * @param[in]   shape - deep, wide or mixed
+ * @param[in]   path - the folder to make it in, which must not exist
+ *
+ * @returns true - tree made
+ * @returns false - unknown shape, or the tree could not be made
+ *
+ ****************************************************************************/
+bool generateTree( const string &shape, const string &path )
+{
+    long long folders, files;
+
+    for ( const treeShape &known : SHAPES )
+    {
+        if ( shape != known.name )
+            continue;
+        if ( !makeTree( known, path, folders, files ) )
+        {
+            cout << "Unable to make the tree in: " << path << endl;
+            return false;
+        }
+        cout << "Made " << folders << " folders and " << files
+            << " files in " << path << endl;
+        return true;
+    }
+    cout << "Unknown tree shape: " << shape << endl;
+    return false;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Drops the system's page cache, so the next walk reads every folder from
+ * the disk. Only Linux lets a program do this, and only with permission.
+ *
+ * @returns true - cache dropped
+ * @returns false - cache could not be dropped
+ *
+ ****************************************************************************/
+bool dropCache()
+{
+#ifdef __linux__
+    FILE *drop;
+    bool ok;
+
+    sync();
+    drop = fopen( "/proc/sys/vm/drop_caches", "w" );
+    if ( drop == NULL )
+        return false;
+    ok = fputs( "3\n", drop ) >= 0;
+    return fclose( drop ) == 0 && ok;
+#else
+    return false;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Walks a tree and writes both xml files, the way the program does without
+ * any options but the threads.
+ *
+ * @param[in]   path - the folder to walk
+ * @param[in]   threads - threads to walk with
+ * @param[in]   xmlFolder - folder to write the xml files in
+ *
+ * @returns true - tree walked and written
+ * @returns false - folder or xml files could not be opened or written
+ *
+ ****************************************************************************/
+bool walkOnce( const string &path, int threads, const string &xmlFolder )
+{
+    xmlWriter gitxml, nonGitxml;
+    shared_ptr<folder> root( new folder, deleteFolder );
+    walkNode tree;
+
+    if ( !xmlOpen( gitxml, joinPath( xmlFolder, "bench_git.xml" ) ) ||
+        !xmlOpen( nonGitxml, joinPath( xmlFolder, "bench_nongit.xml" ) ) ||
+        !openRoot( *root, path ) )
+        return false;
+    gitxml.buffer += "<?xml version=\"1.0\"?>\n<folders>\n";
+    nonGitxml.buffer += "<?xml version=\"1.0\"?>\n<folders>\n";
+    tree.path = root->path;
+    tree.dir = root;
+    tree.opened = true;
+    root.reset();
+    walkTree( tree, threads, nullptr );
+    writeFolders( tree, gitxml, nonGitxml, false );
+    gitxml.buffer += "</folders>\n";
+    nonGitxml.buffer += "</folders>\n";
+    return xmlClose( gitxml ) && xmlClose( nonGitxml );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Times one case. setup runs untimed before every repeat, then work is
+ * timed. Repeats continue until they add up to BENCH_MIN_SECONDS, with at
+ * least three, and the fastest one is kept.
+ *
+ * @param[in]   setup - puts things back the way work expects them
+ * @param[in]   work - the thing being timed
+ *
+ * @returns seconds of the fastest repeat
+ *
+ ****************************************************************************/
+double timeCase( const function<void()> &setup, const function<void()> &work )
+{
+    int runs = 0;
+    double total = 0, seconds, best = 1e30;
+    chrono::steady_clock::time_point start;
+
+    while ( runs < 3 || total < BENCH_MIN_SECONDS )
+    {
+        setup();
+        start = chrono::steady_clock::now();
+        work();
+        seconds = chrono::duration<double>( chrono::steady_clock::now() -
+            start ).count();
+        best = min( best, seconds );
+        total += seconds;
+        runs++;
+    }
+    return best;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Makes a tree of every shape and times walking it with several thread
+ * counts, warm and, where the page cache can be dropped, cold. Results are
+ * written as CSV with a header line, one line per case, with the entries
+ * walked per second and the most folders that were open at once. The trees
+ * and the xml files are made in folders of their own in the current folder,
+ * which must not already exist, and removed afterwards.
+ *
+ * @param[in]   outname - CSV file to write, or empty to write it to the
+ *                        screen
+ *
+ * @returns true - all cases ran
+ * @returns false - a tree or the xml folder could not be made, walked or
+ *          removed
+ *
+ ****************************************************************************/
+bool runBenchmarks( const string &outname )
+{
+    const string scratch = "bench_tree", xmlFolder = "bench_xml";
+    unsigned hardware = thread::hardware_concurrency();
+    vector<int> threadCounts = { 1 };
+    long long folders, files;
+    double seconds, entries;
+    size_t t;
+    int cache, peak;
+    bool ok = true, cold;
+    ofstream results;
+    ostream *out = &cout;
+    char line[256];
+
+    if ( hardware > 1 )
+        threadCounts.push_back( (int)hardware );
+    if ( outname.size() != 0 )
+    {
+        results.open( outname );
+        if ( !results )
+        {
+            cout << "File could not open." << endl;
+            return false;
+        }
+        out = &results;
+    }
+    //a folder that is already there may hold someone's files
+    if ( !makeFolder( xmlFolder ) )
+    {
+        cout << "Unable to make the folder: " << xmlFolder << endl;
+        return false;
+    }
+    //the walks use the default filters
+    compileFilters();
+    cold = dropCache();
+    if ( !cold )
+        cout << "The page cache can't be dropped here, cold cases are "
+            "skipped" << endl;
+    *out << "shape,depth,folders,files,threads,cache,seconds,entries_per_s,"
+        << "open_folders" << '\n';
+
+    for ( const treeShape &shape : SHAPES )
+    {
+        if ( !makeTree( shape, scratch, folders, files ) )
+        {
+            cout << "Unable to make the tree in: " << scratch << endl;
+            //a folder that was already there is not this run's to remove
+            if ( folders > 0 )
+                removeTree( scratch );
+            removeTree( xmlFolder );
+            return false;
+        }
+        entries = (double)( folders + files );
+        for ( t = 0; t < threadCounts.size(); t++ )
+        {
+            for ( cache = 0; cache < ( cold ? 2 : 1 ); cache++ )
+            {
+                takeFolderPeak();
+                auto setup = [&]()
+                {
+                    if ( cache == 1 )
+                        dropCache();
+                };
+                auto walk = [&]()
+                {
+                    ok = walkOnce( scratch, threadCounts[t], xmlFolder ) &&
+                        ok;
+                };
+                seconds = timeCase( setup, walk );
+                peak = takeFolderPeak();
+
+                snprintf( line, sizeof( line ), "%s,%d,%lld,%lld,%d,%s,%.6f,"
+                    "%.0f,%d", shape.name, shape.depth, folders, files,
+                    threadCounts[t], cache == 1 ? "cold" : "warm", seconds,
+                    entries / seconds, peak );
+                *out << line << '\n';
+                out->flush();
+
+                snprintf( line, sizeof( line ), "%-6s %6lld folders %7lld "
+                    "files %2d threads %s %11.0f entries/s %4d open",
+                    shape.name, folders, files, threadCounts[t],
+                    cache == 1 ? "cold" : "warm", entries / seconds, peak );
+                cout << line << endl;
+            }
+        }
+        if ( !removeTree( scratch ) )
+        {
+            cout << "Unable to remove the tree in: " << scratch << endl;
+            removeTree( xmlFolder );
+            return false;
+        }
+    }
+    if ( !removeTree( xmlFolder ) )
+    {
+        cout << "Unable to remove the folder: " << xmlFolder << endl;
+        return false;
+    }
+    return ok;
+}
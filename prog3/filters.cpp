@@ -0,0 +1,353 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Decides which files are output and which folders are skipped
+ *
+ * The rules are patterns given in a filters file or on the command line,
+ * each kind replacing its defaults. They are compiled once before the walk.
+ * Names and patterns of the form *suffix go into a trie of reversed names,
+ * so a name is matched by walking it once from its last character. The
+ * other patterns are matched with * and ? as globs. Neither copies the name
+ * or allocates anything.
+ *
+ * A * at the start of a pattern needs at least one character, so *.h
+ * matches a.h and .a.h but not a file named just .h.
+ ****************************************************************************/
+#include "prog3.h"
+
+/*!
+ * @brief Files output when no file patterns are given
+ */
+static const char *const DEFAULT_FILES[] = { "*.sln", "*.cpp", "*.vcxproj",
+    "*.h", ".gitignore", ".gitattributes" };
+
+/*!
+ * @brief Folders skipped when no skip patterns are given
+ */
+static const char *const DEFAULT_SKIPS[] = { ".git", ".vs", "x64", "Debug" };
+
+/*!
+ * @brief File patterns given so far
+ */
+static vector<string> filePatterns;
+
+/*!
+ * @brief Folder patterns given so far
+ */
+static vector<string> skipPatterns;
+
+/*!
+ * @brief The compiled file patterns
+ */
+static nameFilter fileFilter;
+
+/*!
+ * @brief The compiled folder patterns
+ */
+static nameFilter skipFilter;
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds a pattern to the rules, before they are compiled.
+ *
+ * @param[in]   kind - "file" for files to output, "skip" for folders to
+ *                     skip
+ * @param[in]   pattern - the pattern
+ *
+ * @returns true - pattern added
+ * @returns false - unknown kind or empty pattern
+ *
+ ****************************************************************************/
+bool addFilter( const string &kind, const string &pattern )
+{
+    if ( pattern.empty() )
+        return false;
+    if ( kind == "file" )
+        filePatterns.push_back( pattern );
+    else if ( kind == "skip" )
+        skipPatterns.push_back( pattern );
+    else
+        return false;
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads patterns from a filters file. Each line is a kind and a pattern,
+ * like "file *.hpp" or "skip build*". Blank lines and lines starting with
+ * # are ignored.
+ *
+ * @param[in]   name - name of the filters file
+ *
+ * @returns true - every line read
+ * @returns false - file could not be read or has a bad line
+ *
+ ****************************************************************************/
+bool readFilters( const string &name )
+{
+    ifstream fin( name );
+    string line;
+    size_t start, space, value, end;
+
+    if ( !fin )
+        return false;
+    while ( getline( fin, line ) )
+    {
+        start = line.find_first_not_of( " \t\r" );
+        if ( start == string::npos || line[start] == '#' )
+            continue;
+        end = line.find_last_not_of( " \t\r" ) + 1;
+        space = line.find_first_of( " \t", start );
+        if ( space == string::npos || space >= end )
+            return false;
+        value = line.find_first_not_of( " \t", space );
+        if ( !addFilter( line.substr( start, space - start ),
+            line.substr( value, end - value ) ) )
+            return false;
+    }
+    return !fin.bad();
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds a name to a trie of reversed names, from its last character to its
+ * first.
+ *
+ * @param[in,out] filter - the filter whose trie is added to
+ * @param[in]   name - the name, or the suffix after a leading *
+ * @param[in]   suffix - name is a suffix that needs a character before it
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void addReversed( nameFilter &filter, const string &name, bool suffix )
+{
+    int node = 0, child;
+    size_t k;
+
+    for ( k = name.size(); k > 0; k-- )
+    {
+        child = filter.trie[node].child;
+        while ( child >= 0 && filter.trie[child].letter != name[k - 1] )
+            child = filter.trie[child].sibling;
+        if ( child < 0 )
+        {
+            filter.trie.push_back( trieNode() );
+            child = (int)filter.trie.size() - 1;
+            filter.trie[child].letter = name[k - 1];
+            filter.trie[child].sibling = filter.trie[node].child;
+            filter.trie[node].child = child;
+        }
+        node = child;
+    }
+    if ( suffix )
+        filter.trie[node].suffix = true;
+    else
+        filter.trie[node].exact = true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Compiles a list of patterns into a filter.
+ *
+ * @param[out]  filter - the compiled filter
+ * @param[in]   patterns - the patterns
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void compileFilter( nameFilter &filter, const vector<string> &patterns )
+{
+    size_t k;
+    string rest;
+
+    filter.trie.assign( 1, trieNode() );
+    filter.globs.clear();
+    filter.patterns = patterns;
+    for ( k = 0; k < patterns.size(); k++ )
+    {
+        rest = patterns[k][0] == '*' ? patterns[k].substr( 1 ) : patterns[k];
+        if ( rest.empty() || rest.find_first_of( "*?" ) != string::npos )
+            filter.globs.push_back( patterns[k] );
+        else
+            addReversed( filter, rest, patterns[k][0] == '*' );
+    }
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Compiles the rules given so far, using the defaults for a kind that was
+ * given no patterns. Called once before the walk.
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void compileFilters()
+{
+    if ( filePatterns.empty() )
+        filePatterns.assign( begin( DEFAULT_FILES ), end( DEFAULT_FILES ) );
+    if ( skipPatterns.empty() )
+        skipPatterns.assign( begin( DEFAULT_SKIPS ), end( DEFAULT_SKIPS ) );
+    compileFilter( fileFilter, filePatterns );
+    compileFilter( skipFilter, skipPatterns );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Describes the compiled rules, so a snapshot made under other rules can be
+ * told apart.
+ *
+ * @returns the rules as text
+ *
+ ****************************************************************************/
+string filterRules()
+{
+    string rules = "files";
+    size_t k;
+
+    for ( k = 0; k < fileFilter.patterns.size(); k++ )
+        rules += " " + fileFilter.patterns[k];
+    rules += " skip";
+    for ( k = 0; k < skipFilter.patterns.size(); k++ )
+        rules += " " + skipFilter.patterns[k];
+    return rules;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Matches a name against a glob, where * is any run of characters and ? is
+ * any one character. A * at the start needs at least one character.
+ *
+ * @param[in]   pattern - the glob
+ * @param[in]   name - the name
+ * @param[in]   length - characters in name
+ *
+ * @returns true - name matches
+ * @returns false - name does not match
+ *
+ ****************************************************************************/
+bool globMatch( const char *pattern, const char *name, size_t length )
+{
+    const char *star = nullptr;
+    size_t k = 0, back = 0;
+
+    if ( *pattern == '*' )
+    {
+        if ( length == 0 )
+            return false;
+        name++;
+        length--;
+    }
+    while ( k < length )
+    {
+        if ( *pattern == '*' )
+        {
+            star = ++pattern;
+            back = k;
+        }
+        else if ( *pattern != '\0' &&
+            ( *pattern == '?' || *pattern == name[k] ) )
+        {
+            pattern++;
+            k++;
+        }
+        else if ( star != nullptr )
+        {
+            pattern = star;
+            k = ++back;
+        }
+        else
+            return false;
+    }
+    while ( *pattern == '*' )
+        pattern++;
+    return *pattern == '\0';
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Matches a name against a compiled filter, walking the trie from the end
+ * of the name first and then trying the globs.
+ *
+ * @param[in]   filter - the filter
+ * @param[in]   name - the name
+ * @param[in]   length - characters in name
+ *
+ * @returns true - name matches a pattern
+ * @returns false - name matches none
+ *
+ ****************************************************************************/
+bool matchName( const nameFilter &filter, const char *name, size_t length )
+{
+    const trieNode *trie = filter.trie.data();
+    int node = 0, child;
+    size_t k;
+
+    for ( k = length; k > 0; k-- )
+    {
+        child = trie[node].child;
+        while ( child >= 0 && trie[child].letter != name[k - 1] )
+            child = trie[child].sibling;
+        if ( child < 0 )
+            break;
+        node = child;
+        if ( trie[node].suffix && k > 1 )
+            return true;
+    }
+    if ( k == 0 && trie[node].exact )
+        return true;
+    for ( k = 0; k < filter.globs.size(); k++ )
+        if ( globMatch( filter.globs[k].c_str(), name, length ) )
+            return true;
+    return false;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Checks a file name against the compiled file patterns.
+ *
+ * @param[in]   name - the file name
+ *
+ * @returns true - file is output
+ * @returns false - file is left out
+ *
+ ****************************************************************************/
+bool matchFile( const string &name )
+{
+    return matchName( fileFilter, name.data(), name.size() );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Checks a folder name against the compiled skip patterns.
+ *
+ * @param[in]   name - the folder name
+ *
+ * @returns true - folder is skipped
+ * @returns false - folder is processed
+ *
+ ****************************************************************************/
+bool matchSkip( const string &name )
+{
+    return matchName( skipFilter, name.data(), name.size() );
+}
@@ -0,0 +1,491 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Lists folders without changing the working directory
+ *
+ * Each folder is opened relative to its parent, so no path is looked up
+ * from the root again and the current directory never changes. On Windows
+ * the listing is done with _findfirst on the full path. Everywhere else the
+ * folder is opened with openat on its parent's descriptor and read with
+ * readdir, whose d_type tells folders from files without a stat per entry.
+ *
+ * A parent is held open until its folders have been opened, so on a deep
+ * tree one is held for every level still waiting on a folder. Only so many
+ * are held at once. Past that a folder's folders are opened from the
+ * nearest folder above them that is still held, with the rest of their
+ * path, a piece at a time when it is too long to open in one go.
+ ****************************************************************************/
+#include "prog3.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+/*!
+ * @brief Folders held open for the folders inside them, at most, or a
+ *        quarter of the descriptors the program may have if that is fewer
+ */
+const int MAX_OPEN_FOLDERS = 256;
+
+/*!
+ * @brief Levels between the folders held once half of them are held
+ */
+const int HOLD_SPACING = 32;
+
+/*!
+ * @brief Bytes of a long path opened at a time, well under PATH_MAX
+ */
+const size_t PATH_PIECE = 2048;
+
+/*!
+ * @brief Links to folders are walked as folders
+ */
+static bool followLinks = false;
+
+/*!
+ * @brief Folders open right now
+ */
+static atomic<int> openFolders( 0 );
+
+/*!
+ * @brief Most folders open at once since the peak was last taken
+ */
+static atomic<int> folderPeak( 0 );
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Sets whether links to folders are walked as the folders they point to.
+ * Set before the walk starts.
+ *
+ * @param[in]   follow - walk links to folders
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void setFollowLinks( bool follow )
+{
+    followLinks = follow;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Tells whether links to folders are walked.
+ *
+ * @returns true - links to folders are walked
+ * @returns false - links are listed like files
+ *
+ ****************************************************************************/
+bool followingLinks()
+{
+    return followLinks;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Counts a folder that was just opened.
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void countOpen()
+{
+    int now = ++openFolders, peak = folderPeak;
+
+    while ( now > peak && !folderPeak.compare_exchange_weak( peak, now ) )
+        ;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets how many folders can be held open at once.
+ *
+ * @returns the number of folders
+ *
+ ****************************************************************************/
+int folderLimit()
+{
+#ifndef _WIN32
+    struct rlimit limit;
+
+    if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 &&
+        limit.rlim_cur != RLIM_INFINITY &&
+        limit.rlim_cur / 4 < (rlim_t)MAX_OPEN_FOLDERS )
+        return limit.rlim_cur < 8 ? 1 : (int)( limit.rlim_cur / 4 );
+#endif
+    return MAX_OPEN_FOLDERS;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Tells whether another folder can be held open for the folders inside it.
+ * Every folder is held until half the limit is open. After that only one
+ * every few levels is, so a folder opened from the nearest one held never
+ * has far to look, and the rest of the limit lasts many levels longer.
+ *
+ * @param[in]   dir - the folder, open
+ * @param[in]   above - the open folder it was opened from, nullptr if none
+ *
+ * @returns true - it can be held
+ * @returns false - it has to be closed, its folders opened from above
+ *
+ ****************************************************************************/
+bool canHoldFolder( const folder &dir, const folder *above )
+{
+    static const int limit = folderLimit();
+    int open = openFolders;
+
+    if ( open < limit / 2 )
+        return true;
+    if ( open >= limit )
+        return false;
+    if ( above == nullptr )
+        return true;
+    //its path starts with the path of the folder it was opened from
+    return count( dir.path.begin() + above->path.size(), dir.path.end(),
+        '/' ) >= HOLD_SPACING;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the most folders that were open at once, and starts counting again.
+ *
+ * @returns the most folders open at once since the last call
+ *
+ ****************************************************************************/
+int takeFolderPeak()
+{
+    return folderPeak.exchange( openFolders );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds a name to the end of a folder's path.
+ *
+ * @param[in]   path - path of the folder
+ * @param[in]   name - name of an entry inside it
+ *
+ * @returns the path of the entry
+ *
+ ****************************************************************************/
+string joinPath( const string &path, const string &name )
+{
+#ifdef _WIN32
+    const char separator = '\\';
+#else
+    const char separator = '/';
+#endif
+    //a root folder already ends with the separator
+    if ( !path.empty() && ( path.back() == '/' || path.back() == separator ) )
+        return path + name;
+    return path + separator + name;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Opens the folder the walk starts in. Its full path is found once here,
+ * every folder below gets its path by adding its name to its parent's.
+ *
+ * @param[out]  dir - the opened folder
+ * @param[in]   path - path of the folder, relative to the current directory
+ *                     or full
+ *
+ * @returns true - folder opened
+ * @returns false - folder does not exist or could not be opened
+ *
+ ****************************************************************************/
+bool openRoot( folder &dir, const string &path )
+{
+    char *full;
+#ifdef _WIN32
+    struct _finddata_t found;
+    intptr_t handle;
+
+    full = _fullpath( NULL, path.c_str(), 0 );
+    if ( full == NULL )
+        return false;
+    dir.path = full;
+    free( full );
+    //the folder has to exist and be a folder
+    handle = _findfirst( joinPath( dir.path, "*.*" ).c_str(), &found );
+    if ( handle == -1 )
+        return false;
+    _findclose( handle );
+    return true;
+#else
+    int fd;
+
+    fd = open( path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+    if ( fd < 0 )
+        return false;
+    dir.list = fdopendir( fd );
+    if ( dir.list == nullptr )
+    {
+        close( fd );
+        return false;
+    }
+    countOpen();
+    full = realpath( path.c_str(), NULL );
+    if ( full == NULL )
+    {
+        closeFolder( dir );
+        return false;
+    }
+    dir.path = full;
+    free( full );
+    return true;
+#endif
+}
+
+#ifndef _WIN32
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Opens a folder whose path is too long to open at once, a piece of the
+ * path at a time, each piece inside the folder the last one opened. Pieces
+ * end at a / so no name is cut in two.
+ *
+ * @param[in]   at - descriptor the path starts in, AT_FDCWD for a full path
+ * @param[in]   path - path of the folder from there
+ * @param[in]   last - flags for opening the last piece only
+ *
+ * @returns the descriptor of the folder, -1 if it could not be opened
+ *
+ ****************************************************************************/
+int openPieces( int at, const string &path, int last )
+{
+    int fd = at, inner, flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    size_t start = 0, end;
+
+    while ( start < path.size() )
+    {
+        end = path.size();
+        if ( end - start > PATH_PIECE )
+            end = path.rfind( '/', start + PATH_PIECE );
+        if ( end == string::npos || end <= start )
+            inner = -1; //a name longer than a piece
+        else
+            inner = openat( fd, path.substr( start, end - start ).c_str(),
+                flags | ( end == path.size() ? last : 0 ) );
+        if ( fd != at )
+            close( fd );
+        if ( inner < 0 )
+            return -1;
+        fd = inner;
+        start = end + 1;
+    }
+    return fd;
+}
+#endif
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Opens a folder below a folder that is already open, usually its parent,
+ * from the part of its path below that folder, so only those names are
+ * looked up. A path too long to open at once is opened a piece at a time.
+ * A link is only opened when links to folders are followed.
+ *
+ * @param[out]  dir - the opened folder
+ * @param[in]   above - an open folder it is somewhere inside
+ * @param[in]   path - full path of the folder, starting with above's
+ *
+ * @returns true - folder opened
+ * @returns false - folder could not be opened
+ *
+ ****************************************************************************/
+bool openFolder( folder &dir, const folder &above, const string &path )
+{
+    dir.path = path;
+#ifdef _WIN32
+    return true; //nothing is open until it is read
+#else
+    int last = followLinks ? 0 : O_NOFOLLOW;
+    size_t start = above.path.size();
+    int fd;
+
+    if ( start < path.size() && path[start] == '/' )
+        start++;
+    fd = openat( dirfd( above.list ), path.c_str() + start,
+        O_RDONLY | O_DIRECTORY | O_CLOEXEC | last );
+    if ( fd < 0 && errno == ENAMETOOLONG )
+        fd = openPieces( dirfd( above.list ), path.substr( start ), last );
+    if ( fd < 0 )
+        return false;
+    dir.list = fdopendir( fd );
+    if ( dir.list == nullptr )
+    {
+        close( fd );
+        return false;
+    }
+    countOpen();
+    return true;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Opens a folder from its full path, for a folder with no open folder
+ * above it. A path too long to open at once is opened a piece at a time,
+ * each piece inside the last.
+ *
+ * @param[out]  dir - the opened folder
+ * @param[in]   path - full path of the folder
+ *
+ * @returns true - folder opened
+ * @returns false - folder could not be opened
+ *
+ ****************************************************************************/
+bool openPath( folder &dir, const string &path )
+{
+    dir.path = path;
+#ifdef _WIN32
+    return true; //nothing is open until it is read
+#else
+    int last = followLinks ? 0 : O_NOFOLLOW;
+    int fd;
+
+    fd = open( path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | last );
+    if ( fd < 0 && errno == ENAMETOOLONG )
+        fd = openPieces( AT_FDCWD, path, last );
+    if ( fd < 0 )
+        return false;
+    dir.list = fdopendir( fd );
+    if ( dir.list == nullptr )
+    {
+        close( fd );
+        return false;
+    }
+    countOpen();
+    return true;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds an entry to the end of a buffer, reusing a spare entry and its name
+ * if the buffer has one left from an earlier folder.
+ *
+ * @param[in,out] buffer - the buffer to add to
+ * @param[in]   name - name of the entry
+ * @param[in]   isFolder - entry is a folder
+ * @param[in]   inode - inode the listing gave the entry, 0 if none
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void addEntry( entryBuffer &buffer, const char *name, bool isFolder,
+    unsigned long long inode )
+{
+    if ( buffer.used == buffer.entries.size() )
+        buffer.entries.push_back( folderEntry() );
+    buffer.entries[buffer.used].name = name;
+    buffer.entries[buffer.used].isFolder = isFolder;
+    buffer.entries[buffer.used].inode = inode;
+    buffer.used++;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads every entry of a folder, in the order the system lists them, onto
+ * the end of a buffer. The self reference '.' and parent reference '..' are
+ * listed like on Windows. Where the file system does not fill in d_type,
+ * the entry is looked at with fstatat. Unless links to folders are
+ * followed, a link to a folder is listed like a file. The inode a folder
+ * is listed with is kept; it only differs from the inode of the folder
+ * once opened when something else was put over it, a link or a mount.
+ *
+ * @param[in]   dir - the open folder
+ * @param[in,out] buffer - the buffer the entries are added to
+ *
+ * @returns true - folder listed
+ * @returns false - folder could not be listed
+ *
+ ****************************************************************************/
+bool readFolder( folder &dir, entryBuffer &buffer )
+{
+#ifdef _WIN32
+    intptr_t handle;
+    _finddata_t found;
+
+    handle = _findfirst( joinPath( dir.path, "*.*" ).c_str(), &found );
+    if ( handle == -1 )
+        return false;
+    do
+    {
+        addEntry( buffer, found.name, ( found.attrib & _A_SUBDIR ) != 0, 0 );
+    } while ( _findnext( handle, &found ) == 0 );
+    _findclose( handle );
+    return true;
+#else
+    dirent *item;
+    struct stat info;
+    bool isFolder;
+
+    while ( ( item = readdir( dir.list ) ) != nullptr )
+    {
+        isFolder = item->d_type == DT_DIR;
+        if ( ( item->d_type == DT_UNKNOWN ||
+            ( item->d_type == DT_LNK && followLinks ) ) &&
+            fstatat( dirfd( dir.list ), item->d_name, &info,
+            followLinks ? 0 : AT_SYMLINK_NOFOLLOW ) == 0 )
+            isFolder = S_ISDIR( info.st_mode );
+        addEntry( buffer, item->d_name, isFolder,
+            (unsigned long long)item->d_ino );
+    }
+    return true;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Closes a folder and anything its listing holds open.
+ *
+ * @param[in]   dir - the folder to close
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void closeFolder( folder &dir )
+{
+#ifndef _WIN32
+    if ( dir.list != nullptr )
+    {
+        closedir( dir.list );
+        openFolders--;
+    }
+    dir.list = nullptr;
+#endif
+}
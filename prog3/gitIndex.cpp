@@ -0,0 +1,484 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Reads the index of a git repository to tell tracked files from
+ *        untracked ones
+ *
+ * The index at .git/index of each repository found in the walk is mapped
+ * and read once, versions 2 through 4, and the hash of every path in it is
+ * kept in a set. A split index keeps most of its entries in a shared index
+ * file, which is read too, less the entries the split index deleted. Each
+ * folder of the repository keeps the hash of its path inside the
+ * repository, so checking a file only hashes its name onto that and looks
+ * it up, without building its path. A repository whose index can't be read
+ * has none, and its files are written without a status.
+ *
+ * Sparse directory entries stand for folders that are not checked out, so
+ * no file on disk can be in them, and they are left out. Two different
+ * paths with the same 64 bit hash would be taken for each other.
+ ****************************************************************************/
+#include "prog3.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/*!
+ * @brief Hash of the empty path, where the paths of a repository start
+ */
+const unsigned long long INDEX_ROOT = 0xcbf29ce484222325ull;
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a big endian number, the way git writes them.
+ *
+ * @param[in]   data - where the number is
+ * @param[in]   bytes - bytes it is written in
+ *
+ * @returns the number
+ *
+ ****************************************************************************/
+unsigned long long getBigNumber( const char *data, int bytes )
+{
+    unsigned long long value = 0;
+    int b;
+
+    for ( b = 0; b < bytes; b++ )
+        value = ( value << 8 ) | (unsigned char)data[b];
+    return value;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Checks the config of a repository for objects named with SHA-256, whose
+ * index entries hold longer object names.
+ *
+ * @param[in]   repository - full path of the folder holding .git
+ *
+ * @returns true - objects are named with SHA-256
+ * @returns false - objects are named with SHA-1
+ *
+ ****************************************************************************/
+bool usesSha256( const string &repository )
+{
+    ifstream fin( joinPath( joinPath( repository, ".git" ), "config" ) );
+    string line;
+    size_t k;
+
+    while ( getline( fin, line ) )
+    {
+        for ( k = 0; k < line.size(); k++ )
+            line[k] = (char)tolower( (unsigned char)line[k] );
+        if ( line.find( "objectformat" ) != string::npos &&
+            line.find( "sha256" ) != string::npos )
+            return true;
+    }
+    return false;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets what the index file of a repository looks like now, so a snapshot
+ * can tell whether it changed. A repository without an index has the stamp
+ * 1.
+ *
+ * @param[in]   repository - full path of the folder holding .git
+ * @param[out]  stamp - hash of the index file's size, inode and times
+ * @param[out]  modified - last change to the index file, in ns
+ *
+ * @returns true - index looked at, or there is none
+ * @returns false - index could not be looked at
+ *
+ ****************************************************************************/
+bool stampIndex( const string &repository, unsigned long long &stamp,
+    long long &modified )
+{
+    string name = joinPath( joinPath( repository, ".git" ), "index" );
+    unsigned long long fields[4];
+#ifdef _WIN32
+    struct _stat64 info;
+
+    if ( _stat64( name.c_str(), &info ) != 0 )
+    {
+        stamp = 1;
+        modified = 0;
+        return errno == ENOENT;
+    }
+    modified = (long long)info.st_mtime * 1000000000;
+    fields[2] = 0;
+    fields[3] = (unsigned long long)info.st_ctime * 1000000000;
+#else
+    struct stat info;
+
+    if ( stat( name.c_str(), &info ) != 0 )
+    {
+        stamp = 1;
+        modified = 0;
+        return errno == ENOENT;
+    }
+    modified = (long long)info.st_mtim.tv_sec * 1000000000 +
+        info.st_mtim.tv_nsec;
+    fields[2] = (unsigned long long)info.st_ino;
+    fields[3] = (unsigned long long)info.st_ctim.tv_sec * 1000000000 +
+        info.st_ctim.tv_nsec;
+#endif
+    fields[0] = (unsigned long long)info.st_size;
+    fields[1] = (unsigned long long)modified;
+    stamp = hashBytes( (const char *)fields, sizeof( fields ) ) | 2;
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads the entries of a mapped index file into the hash of each path, in
+ * the order they are written. The paths of version 4 only hold what
+ * differs from the path before, so each one is built onto the last.
+ * Entries with no path to check, sparse folders and the entries of a split
+ * index that only replace one of the shared index, get 0. The link
+ * extension of a split index, naming its shared index, is found after the
+ * entries.
+ *
+ * @param[out]  entries - hash of the path of every entry
+ * @param[out]  link - the link extension, nullptr if there is none
+ * @param[out]  linkSize - bytes in the link extension
+ * @param[in]   data - the mapped file
+ * @param[in]   size - bytes in the file
+ * @param[in]   idSize - bytes in an object name, 20 for SHA-1
+ *
+ * @returns true - every entry read
+ * @returns false - not an index this can read, or it is damaged
+ *
+ ****************************************************************************/
+bool parseIndex( vector<unsigned long long> &entries, const char *&link,
+    size_t &linkSize, const char *data, size_t size, size_t idSize )
+{
+    const char *p, *q, *nul, *end;
+    unsigned long long version, count, k, strip, mode, flags, bytes;
+    unsigned char c;
+    string path;
+
+    link = nullptr;
+    linkSize = 0;
+    if ( size < 12 + idSize || memcmp( data, "DIRC", 4 ) != 0 )
+        return false;
+    version = getBigNumber( data + 4, 4 );
+    count = getBigNumber( data + 8, 4 );
+    if ( version < 2 || version > 4 )
+        return false;
+    p = data + 12;
+    end = data + size - idSize; //the file ends in a hash of itself
+    entries.reserve( (size_t)count );
+    for ( k = 0; k < count; k++ )
+    {
+        //times, device, inode, mode, owner, size, object name and flags
+        if ( (size_t)( end - p ) < 42 + idSize )
+            return false;
+        mode = getBigNumber( p + 24, 4 );
+        flags = getBigNumber( p + 40 + idSize, 2 );
+        q = p + 42 + idSize;
+        if ( flags & 0x4000 )
+        {
+            if ( version < 3 || end - q < 2 )
+                return false;
+            q += 2;
+        }
+        if ( version == 4 )
+        {
+            //how much of the last path to drop, 7 bits at a time
+            strip = 0;
+            do
+            {
+                if ( q == end || strip > path.size() )
+                    return false;
+                c = (unsigned char)*q++;
+                strip = ( strip << 7 ) | ( c & 127 );
+                if ( c & 128 )
+                    strip++;
+            } while ( c & 128 );
+            nul = (const char *)memchr( q, 0, end - q );
+            if ( nul == nullptr || strip > path.size() )
+                return false;
+            path.resize( path.size() - (size_t)strip );
+            path.append( q, nul );
+            p = nul + 1;
+            q = path.data();
+            nul = q + path.size();
+        }
+        else
+        {
+            nul = (const char *)memchr( q, 0, end - q );
+            if ( nul == nullptr )
+                return false;
+            //entries are padded with 1 to 8 nuls to a multiple of 8 bytes
+            p += ( ( q - p ) + ( nul - q ) + 8 ) & ~(size_t)7;
+            if ( p > end )
+                return false;
+        }
+        if ( ( mode & 0170000 ) != 0040000 && nul != q )
+            entries.push_back( hashBytes( q, nul - q ) );
+        else
+            entries.push_back( 0 );
+    }
+
+    //extensions, each a signature, its size and its data
+    while ( end - p >= 8 )
+    {
+        bytes = getBigNumber( p + 4, 4 );
+        if ( bytes > (size_t)( end - p - 8 ) )
+            return false;
+        if ( memcmp( p, "link", 4 ) == 0 )
+        {
+            link = p + 8;
+            linkSize = (size_t)bytes;
+        }
+        p += 8 + bytes;
+    }
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a bitmap of the link extension, written the way git writes them,
+ * compressed with EWAH: a word giving a run of all 0 or all 1 words and how
+ * many literal words follow it, then those words, over and over. Bit k of
+ * literal word w is position 64 * w + k.
+ *
+ * @param[in,out] p - where the bitmap starts, moved past it
+ * @param[in]   end - end of the extension
+ * @param[in,out] bits - marked at every position set in the bitmap,
+ *                       positions past its size are ignored
+ *
+ * @returns true - bitmap read
+ * @returns false - bitmap is damaged
+ *
+ ****************************************************************************/
+bool readBitmap( const char *&p, const char *end, vector<bool> &bits )
+{
+    unsigned long long words, word, run, literals, k, n, at = 0;
+    const char *q;
+    int b;
+
+    //bits in the bitmap, words in it, the words, the last run word
+    if ( end - p < 8 )
+        return false;
+    words = getBigNumber( p + 4, 4 );
+    if ( (unsigned long long)( end - p ) < 12 + 8 * words )
+        return false;
+    q = p + 8;
+    p += 12 + 8 * words;
+    for ( k = 0; k < words && at < bits.size(); )
+    {
+        word = getBigNumber( q + 8 * k++, 8 );
+        run = ( word >> 1 ) & 0xffffffffull;
+        literals = word >> 33;
+        for ( n = 0; ( word & 1 ) && n < 64 * run && at + n < bits.size();
+            n++ )
+            bits[(size_t)( at + n )] = true;
+        at += 64 * run;
+        for ( n = 0; n < literals && k < words; n++, k++ )
+        {
+            word = getBigNumber( q + 8 * k, 8 );
+            for ( b = 0; b < 64 && at + b < bits.size(); b++ )
+                if ( ( word >> b ) & 1 )
+                    bits[(size_t)( at + b )] = true;
+            at += 64;
+        }
+    }
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Maps an index file and reads its entries. A shared index can't link to
+ * another one, so that is taken as damage.
+ *
+ * @param[out]  entries - hash of the path of every entry
+ * @param[in]   name - full path of the index file
+ * @param[in]   idSize - bytes in an object name, 20 for SHA-1
+ *
+ * @returns true - every entry read
+ * @returns false - file could not be mapped, or is not an index this can
+ *          read
+ *
+ ****************************************************************************/
+bool readSharedIndex( vector<unsigned long long> &entries,
+    const string &name, size_t idSize )
+{
+    const char *data, *link;
+    size_t size, linkSize;
+    void *mapping;
+    bool read;
+
+    if ( !mapFile( name, data, size, mapping ) )
+        return false;
+    read = parseIndex( entries, link, linkSize, data, size, idSize ) &&
+        link == nullptr;
+    unmapFile( data, size, mapping );
+    return read;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Puts the paths of a split index together. The link extension names the
+ * shared index, .git/sharedindex.<name in hex>, which holds most of the
+ * entries, and is followed by a bitmap of the shared entries that were
+ * deleted and one of those replaced by an entry of the split index. A
+ * replacing entry has the same path, so only the deleted ones matter.
+ *
+ * @param[in,out] index - the index, given the paths of the shared index
+ * @param[in]   repository - full path of the folder holding .git
+ * @param[in]   link - the link extension
+ * @param[in]   linkSize - bytes in the link extension
+ * @param[in]   idSize - bytes in an object name, 20 for SHA-1
+ *
+ * @returns true - shared index read
+ * @returns false - shared index or the link is missing or damaged
+ *
+ ****************************************************************************/
+bool readLink( gitIndex &index, const string &repository, const char *link,
+    size_t linkSize, size_t idSize )
+{
+    const char *p = link + idSize;
+    vector<unsigned long long> shared;
+    vector<bool> deleted;
+    string name = "sharedindex.";
+    size_t k;
+
+    if ( linkSize < idSize )
+        return false;
+    if ( count( link, p, '\0' ) == (ptrdiff_t)idSize )
+        return true; //no shared index, every entry is in this file
+    for ( k = 0; k < idSize; k++ )
+    {
+        name += "0123456789abcdef"[(unsigned char)link[k] >> 4];
+        name += "0123456789abcdef"[(unsigned char)link[k] & 15];
+    }
+    if ( !readSharedIndex( shared,
+        joinPath( joinPath( repository, ".git" ), name ), idSize ) )
+        return false;
+    deleted.assign( shared.size(), false );
+    if ( p != link + linkSize && !readBitmap( p, link + linkSize, deleted ) )
+        return false;
+    for ( k = 0; k < shared.size(); k++ )
+        if ( shared[k] != 0 && !deleted[k] )
+            index.paths.insert( shared[k] );
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Loads the index of a repository, and its shared index if it is split. A
+ * repository without an index has nothing tracked. One whose index cannot
+ * be read has no index at all, so its files are not marked either way.
+ *
+ * @param[in]   repository - full path of the folder holding .git
+ *
+ * @returns the index, nullptr if it could not be read
+ *
+ ****************************************************************************/
+shared_ptr<gitIndex> loadIndex( const string &repository )
+{
+    shared_ptr<gitIndex> index( new gitIndex );
+    vector<unsigned long long> entries;
+    const char *data, *link;
+    size_t size, linkSize, k, idSize;
+    void *mapping;
+    bool read;
+
+    if ( !stampIndex( repository, index->stamp, index->modified ) )
+        return nullptr;
+    if ( index->stamp == 1 )
+        return index;
+    if ( !mapFile( joinPath( joinPath( repository, ".git" ), "index" ), data,
+        size, mapping ) )
+        return nullptr;
+    idSize = usesSha256( repository ) ? 32 : 20;
+    read = parseIndex( entries, link, linkSize, data, size, idSize ) &&
+        ( link == nullptr ||
+        readLink( *index, repository, link, linkSize, idSize ) );
+    unmapFile( data, size, mapping );
+    if ( !read )
+        return nullptr;
+    for ( k = 0; k < entries.size(); k++ )
+        if ( entries[k] != 0 )
+            index->paths.insert( entries[k] );
+    return index;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Loads the index of the repository a folder holds, making the folder the
+ * top of the paths in it, and watches the index for changes when watching.
+ *
+ * @param[in,out] node - a folder with a .git folder in it
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void openIndex( walkNode &node )
+{
+    node.index = loadIndex( node.path );
+    node.indexPrefix = INDEX_ROOT;
+    watchIndex( node );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the hash of the path of a folder inside a folder, as it would be
+ * written in the index.
+ *
+ * @param[in]   node - the outer folder
+ * @param[in]   name - name of the folder inside it
+ *
+ * @returns the hash of the path with a / on the end, 0 if the folder is
+ *          not in a repository
+ *
+ ****************************************************************************/
+unsigned long long indexFolder( const walkNode &node, const string &name )
+{
+    if ( node.index == nullptr )
+        return 0;
+    return hashMore( hashMore( node.indexPrefix, name.data(), name.size() ),
+        "/", 1 );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Checks whether a file of a folder is in its repository's index.
+ *
+ * @param[in]   node - the folder, which has to be in a repository
+ * @param[in]   name - name of the file
+ *
+ * @returns true - file is tracked
+ * @returns false - file is untracked
+ *
+ ****************************************************************************/
+bool isTracked( const walkNode &node, const string &name )
+{
+    return node.index->paths.count( hashMore( node.indexPrefix, name.data(),
+        name.size() ) ) != 0;
+}
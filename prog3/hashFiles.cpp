@@ -0,0 +1,400 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Hashes the output files on their own threads while the walk goes on
+ *
+ * A walk thread that finds output files in a folder puts one job per file
+ * on a bounded queue and goes on walking; it only waits when the queue is
+ * full. The hashing threads take the jobs, read each file, and fill in its
+ * size and git blob SHA-1, the name git would give it as an object, so it
+ * can be checked against the object names in the index. Files are read
+ * into a buffer each thread keeps, with a single read if they are smaller
+ * than a megabyte and a megabyte at a time if not. They are not mapped, as
+ * a mapped file cut short while it is hashed would kill the program. A
+ * folder's file lines are written from the results once every job is done,
+ * in the order the files were listed.
+ ****************************************************************************/
+#include "prog3.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+/*!
+ * @brief Jobs waiting before the walk has to wait for the hashing
+ */
+const size_t HASH_QUEUE_SIZE = 4096;
+
+/*!
+ * @brief Bytes from which a file is read in chunks, and the size of them
+ */
+const long long HASH_CHUNK_SIZE = 1 << 20;
+
+/*!
+ * @brief One file to hash
+ */
+struct hashJob
+{
+    walkNode *node;             /*!< Folder the file is in*/
+    size_t slot;                /*!< The file in the folder's files*/
+};
+
+/*!
+ * @brief The queue of files to hash and the threads hashing them
+ */
+struct hashStage
+{
+    mutex lock;                 /*!< Guards everything below*/
+    condition_variable notFull; /*!< Signalled when a job is taken*/
+    condition_variable notEmpty;/*!< Signalled when a job is queued*/
+    condition_variable idle;    /*!< Signalled when the last job is done*/
+    deque<hashJob> jobs;        /*!< Jobs not yet taken*/
+    size_t busy = 0;            /*!< Jobs being hashed*/
+    bool stopping = false;      /*!< Threads are to finish*/
+    vector<thread> workers;     /*!< The hashing threads*/
+};
+
+/*!
+ * @brief The hashing stage, no threads when files are not hashed
+ */
+static hashStage stage;
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Hashes the bytes of a file as a git blob, which is the word blob, its
+ * size and a nul, then the bytes.
+ *
+ * @param[out]  file - the file, which gets its size and hash
+ * @param[in]   data - the bytes of the file
+ * @param[in]   size - number of bytes
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void hashBlob( hashedFile &file, const char *data, size_t size )
+{
+    sha1State sha;
+    string header = "blob " + to_string( size );
+
+    sha1Start( sha );
+    sha1Add( sha, header.c_str(), header.size() + 1 );
+    sha1Add( sha, data, size );
+    sha1Finish( sha, file.sha1 );
+    file.size = (long long)size;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Hashes a large file as a git blob, reading it a chunk at a time. The size
+ * goes first in the blob, so a file that is cut short or grows while it is
+ * read gets no hash. It has changed, and will be looked at again if the
+ * tree is being watched.
+ *
+ * @param[in]   fd - the file, open at its start
+ * @param[in]   size - bytes in the file when it was opened
+ * @param[out]  file - the file, which gets its size and hash
+ * @param[in,out] buffer - space to read into, kept by the thread
+ *
+ * @returns true - file hashed
+ * @returns false - file could not be read or changed size
+ *
+ ****************************************************************************/
+bool hashChunks( int fd, long long size, hashedFile &file,
+    vector<char> &buffer )
+{
+    sha1State sha;
+    string header = "blob " + to_string( size );
+    long long done = 0, got;
+
+    buffer.resize( (size_t)HASH_CHUNK_SIZE );
+    sha1Start( sha );
+    sha1Add( sha, header.c_str(), header.size() + 1 );
+    do
+    {
+        //one byte past the end is asked for, to see the file has not grown
+        got = min( size - done + 1, HASH_CHUNK_SIZE );
+#ifdef _WIN32
+        got = _read( fd, buffer.data(), (unsigned)got );
+#else
+        got = (long long)read( fd, buffer.data(), (size_t)got );
+#endif
+        if ( got < 0 || got > size - done )
+            return false;
+        sha1Add( sha, buffer.data(), (size_t)got );
+        done += got;
+    } while ( got > 0 );
+    if ( done != size )
+        return false;
+    sha1Finish( sha, file.sha1 );
+    file.size = size;
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a file and hashes it. A link is hashed the way git stores it, as
+ * the path it points to.
+ *
+ * @param[in]   path - full path of the file
+ * @param[in,out] file - the file, which gets its size and hash
+ * @param[in,out] buffer - space to read the file into, kept by the thread
+ *
+ * @returns true - file hashed
+ * @returns false - file could not be read, it is left without a hash
+ *
+ ****************************************************************************/
+bool hashFile( const string &path, hashedFile &file, vector<char> &buffer )
+{
+#ifdef _WIN32
+    struct _stat64 info;
+    int fd, got;
+    bool hashed;
+
+    fd = _open( path.c_str(), _O_RDONLY | _O_BINARY );
+    if ( fd < 0 )
+        return false;
+    if ( _fstat64( fd, &info ) != 0 || !( info.st_mode & _S_IFREG ) )
+    {
+        _close( fd );
+        return false;
+    }
+    if ( info.st_size >= HASH_CHUNK_SIZE )
+    {
+        hashed = hashChunks( fd, (long long)info.st_size, file, buffer );
+        _close( fd );
+        return hashed;
+    }
+    buffer.resize( (size_t)info.st_size + 1 );
+    got = _read( fd, buffer.data(), (unsigned)buffer.size() );
+    _close( fd );
+    if ( got < 0 )
+        return false;
+    hashBlob( file, buffer.data(), (size_t)got );
+    return true;
+#else
+    struct stat info;
+    ssize_t got;
+    size_t size = 0;
+    int fd;
+    bool hashed;
+
+    fd = open( path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NONBLOCK );
+    if ( fd < 0 && errno == ELOOP )
+    {
+        buffer.resize( 4096 );
+        got = readlink( path.c_str(), buffer.data(), buffer.size() );
+        if ( got < 0 )
+            return false;
+        hashBlob( file, buffer.data(), (size_t)got );
+        return true;
+    }
+    if ( fd < 0 )
+        return false;
+    if ( fstat( fd, &info ) != 0 || !S_ISREG( info.st_mode ) )
+    {
+        close( fd );
+        return false;
+    }
+    if ( info.st_size >= HASH_CHUNK_SIZE )
+    {
+        hashed = hashChunks( fd, (long long)info.st_size, file, buffer );
+        close( fd );
+        return hashed;
+    }
+    //a single read unless the file is being cut short
+    buffer.resize( (size_t)info.st_size + 1 );
+    got = 0;
+    while ( size < (size_t)info.st_size && ( got = read( fd,
+        buffer.data() + size, (size_t)info.st_size - size ) ) > 0 )
+        size += (size_t)got;
+    close( fd );
+    if ( got < 0 )
+        return false;
+    hashBlob( file, buffer.data(), size );
+    return true;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Runs one hashing thread. It takes jobs until the stage is stopped and the
+ * queue is empty.
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void hashWorker()
+{
+    vector<char> buffer;
+    hashJob job;
+
+    while ( true )
+    {
+        {
+            unique_lock<mutex> guard( stage.lock );
+            stage.notEmpty.wait( guard, []()
+                { return !stage.jobs.empty() || stage.stopping; } );
+            if ( stage.jobs.empty() )
+                return;
+            job = stage.jobs.front();
+            stage.jobs.pop_front();
+            stage.busy++;
+        }
+        stage.notFull.notify_one();
+        hashFile( joinPath( job.node->path, job.node->files[job.slot].name ),
+            job.node->files[job.slot], buffer );
+        {
+            lock_guard<mutex> guard( stage.lock );
+            stage.busy--;
+            if ( stage.busy == 0 && stage.jobs.empty() )
+                stage.idle.notify_all();
+        }
+    }
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Starts the hashing threads. From then on the output files of every folder
+ * processed are hashed.
+ *
+ * @param[in]   threads - threads to hash with, 0 for one per processor
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void startHashing( int threads )
+{
+    int k;
+
+    if ( threads <= 0 )
+        threads = (int)thread::hardware_concurrency();
+    if ( threads <= 0 )
+        threads = 1;
+    for ( k = 0; k < threads; k++ )
+        stage.workers.push_back( thread( hashWorker ) );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Tells whether output files are being hashed.
+ *
+ * @returns true - files are hashed
+ * @returns false - files are not hashed
+ *
+ ****************************************************************************/
+bool hashingFiles()
+{
+    return !stage.workers.empty();
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Queues every output file of a folder to be hashed, waiting whenever the
+ * queue is full. The folder's files must not change until they are done.
+ *
+ * @param[in,out] node - the folder, with its files
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void queueHashes( walkNode &node )
+{
+    size_t k;
+
+    for ( k = 0; k < node.files.size(); k++ )
+    {
+        {
+            unique_lock<mutex> guard( stage.lock );
+            stage.notFull.wait( guard, []()
+                { return stage.jobs.size() < HASH_QUEUE_SIZE; } );
+            stage.jobs.push_back( { &node, k } );
+        }
+        stage.notEmpty.notify_one();
+    }
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Waits until every file queued so far has been hashed.
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void waitHashing()
+{
+    unique_lock<mutex> guard( stage.lock );
+
+    stage.idle.wait( guard, []()
+        { return stage.jobs.empty() && stage.busy == 0; } );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Waits for the files queued so far and stops the hashing threads.
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void finishHashing()
+{
+    size_t k;
+
+    waitHashing();
+    {
+        lock_guard<mutex> guard( stage.lock );
+        stage.stopping = true;
+    }
+    stage.notEmpty.notify_all();
+    for ( k = 0; k < stage.workers.size(); k++ )
+        stage.workers[k].join();
+    stage.workers.clear();
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds the lines of a folder's hashed files after its folder line, once
+ * they are all done, and lets go of the files.
+ *
+ * @param[in,out] node - the folder
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void outputHashedFiles( walkNode &node )
+{
+    size_t k;
+
+    for ( k = 0; k < node.files.size(); k++ )
+        outputFile( node.lines, node.depth, node.files[k].name,
+            node.files[k].status, node.files[k].size, node.files[k].sha1 );
+    node.files.clear();
+    node.files.shrink_to_fit();
+}
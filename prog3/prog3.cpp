@@ -34,20 +34,54 @@
  * processed are: .git, .vs, x64, Debug, the self reference folder '.' and a 
  * reference to the previous directory '..' .Only files with certain extensions 
  * are to be processed. These extensions are: .sln, .cpp, .vcxproj, .h, and two
- * files that are named exactly ".gitignore" and ".gitattribute". Required 
- * lines and tags are outputted during the program to ensure that the xml is
- * formatted correctly. XML files can be viewed by opening with wordpad, but
+ * files that are named exactly ".gitignore" and ".gitattribute". Both lists
+ * can be replaced with patterns from a filters file or the command line,
+ * except for '.' and '..', which are never processed. Files in a git
+ * repository are marked tracked or untracked, from the repository's index.
+ * With --hash each file also gets its size and git blob SHA-1.
+ * Required lines and tags are outputted during the program to ensure that
+ * the xml is formatted correctly. XML files can be viewed by opening with wordpad, but
  * it won't be formatted. To view it formatted, you can drag to a browser and
  * view it there. There are other ways to do it, but this is the easiest.
  *
  * @section compile_section Compiling and Usage 
  *
  * @par Compiling Instructions: 
- *      none
+ *      Build the solution in Visual Studio, or on Linux and other POSIX
+ *      systems: g++ -O2 -pthread -o prog3 *.cpp
  * 
  * @par Usage: 
    @verbatim  
-   c:\> prog3.exe [folder path to process] [Git file name] [Non-git file name]
+   c:\> prog3.exe [--threads #] [folder path to process] [Git file name]
+        [Non-git file name]
+   c:\> prog3.exe --generate deep|wide|mixed [folder path to make]
+   c:\> prog3.exe --bench [results.csv]
+
+   --threads #   Walk the folders on this many threads (default one per
+                 processor), the xml files come out the same either way
+   --indent      Indent the xml two spaces for each level of folders
+   --snapshot f  Keep what each folder held in file f, and skip reading
+                 the folders that have not changed since it was made
+   --watch #     Keep running and write the xml files again whenever the
+                 folders change, once changes stop for # milliseconds
+   --filters f   Read file and folder patterns from file f, one per line
+                 as "file *.hpp" or "skip build*", # starts a comment
+   --file p      Output files matching pattern p instead of the default
+                 files, can be given more than once
+   --skip p      Skip folders matching pattern p instead of the default
+                 folders, can be given more than once
+   --hash        Add the size and git blob SHA-1 of each file, hashed on
+                 their own threads; --snapshot is not used, since editing
+                 a file does not change its folder's times
+   --follow      Walk links to folders as folders; a folder reached again
+                 inside itself, through a link or a mount, is output empty
+   --generate    Make a deep, wide or mixed tree of folders to try it on
+   --bench       Time walking generated trees of each shape, warm and with
+                 the page cache dropped where allowed, as CSV
+
+   Patterns may use * for any characters and ? for any one character. A
+   * at the start needs at least one character, so *.h does not match a
+   file named just .h.
    @endverbatim 
  *
  * @section todo_bugs_modification_section Todo, Bugs, and Modifications
@@ -74,23 +108,7 @@
    @endverbatim
  *
  ****************************************************************************/
-#include <iostream>
-#include <direct.h>
-#include <io.h>
-#include <fstream>
-#include <string>
-
-using namespace std;
-
-//prototypes
-void processFiles( ofstream &gitxml, ofstream &nonGitxml, bool git );
-bool isGit();
-bool isValidFolder( string filename, _finddata_t a_file );
-void outputFiles( string filename, bool git, ofstream &gitxml, 
-    ofstream &nonGitxml );
-void outputClosingTag( ofstream &gitxml, ofstream &nonGitxml, bool git );
-void outputFolder( ofstream &gitxml, ofstream &nonGitxml, bool git,
-    char *directory );
+#include "prog3.h"
 
 /*************************************************************************//**
  * @author Dillon Roller
@@ -98,10 +116,12 @@ void outputFolder( ofstream &gitxml, ofstream &nonGitxml, bool git,
  * @par Description: 
  * Controls the flow of the program. Checks that command line arguments are
  * valid and initializes variables. Handles the opening and closing of xml 
- * files and outputs required lines to each. It then changes directory to 
- * the folder that needs processing and recusively processes folders in that
- * folder. After all folders have been processed, it outputs closing tags for
- * the folders section. 
+ * files and outputs required lines to each. It then opens the folder that
+ * needs processing and processes every folder below it, on as many threads
+ * as asked for, and writes them all out in order. After all folders have
+ * been processed, it outputs closing tags for the folders section. When
+ * watching, it then keeps the folders in memory and writes the xml files
+ * again each time they change.
  * 
  * @param[in]   argc - Number of arguments entered through command line
  * @param[in]   argv - 2D c-style array containing arguments entered     
@@ -109,8 +129,11 @@ void outputFolder( ofstream &gitxml, ofstream &nonGitxml, bool git,
  * @returns 0 Program ran successful.
  * @returns 1 Invalid number of command line arguments  
  * @returns 2 Invalid file type
- * @returns 3 XML files failed to open
- * @returns 4 Unable to change into main folder to process (Doesn't exist)
+ * @returns 3 XML files failed to open or write
+ * @returns 4 Unable to open main folder to process (Doesn't exist)
+ * @returns 5 Unable to watch the folders
+ * @returns 6 Invalid filters
+ * @returns 7 The tree could not be generated or benchmarked
  * 
  ****************************************************************************/
 int main( int argc, char* argv[] )
@@ -119,18 +142,85 @@ int main( int argc, char* argv[] )
     string dirpath,
         git,
         nonGit;
-    bool gitbool;
-    ofstream gitxml, nonGitxml;
+    xmlWriter gitxml, nonGitxml;
+    shared_ptr<folder> root( new folder, deleteFolder );
+    walkNode tree;
+    int threads = 0;
+    int interval = 0;
+    bool hash = false;
+    snapshot previous;
+    //the tree generator and the benchmark need no xml files
+    if ( argc == 4 && string( argv[1] ) == "--generate" )
+        return generateTree( argv[2], argv[3] ) ? 0 : 7;
+    if ( argc > 1 && string( argv[1] ) == "--bench" )
+        return runBenchmarks( argc > 2 ? argv[2] : "" ) ? 0 : 7;
+    //take off the options that come first
+    while ( argc > 1 )
+    {
+        if ( argc > 2 && string( argv[1] ) == "--threads" )
+        {
+            threads = atoi( argv[2] );
+            argv++;
+            argc--;
+        }
+        else if ( string( argv[1] ) == "--indent" )
+            setXmlIndent( 2 );
+        else if ( string( argv[1] ) == "--hash" )
+            hash = true;
+        else if ( string( argv[1] ) == "--follow" )
+            setFollowLinks( true );
+        else if ( argc > 2 && string( argv[1] ) == "--snapshot" )
+        {
+            previous.name = argv[2];
+            argv++;
+            argc--;
+        }
+        else if ( argc > 2 && string( argv[1] ) == "--filters" )
+        {
+            if ( !readFilters( argv[2] ) )
+            {
+                cout << "Invalid filters file: " << argv[2] << endl;
+                return 6;
+            }
+            argv++;
+            argc--;
+        }
+        else if ( argc > 2 && ( string( argv[1] ) == "--file" ||
+            string( argv[1] ) == "--skip" ) )
+        {
+            if ( !addFilter( argv[1] + 2, argv[2] ) )
+            {
+                cout << "Invalid pattern: " << argv[2] << endl;
+                return 6;
+            }
+            argv++;
+            argc--;
+        }
+        else if ( argc > 2 && string( argv[1] ) == "--watch" )
+        {
+            interval = atoi( argv[2] );
+            if ( interval < 1 )
+                interval = 1;
+            argv++;
+            argc--;
+        }
+        else
+            break;
+        argv++;
+        argc--;
+    }
     //check for proper number of command line arguments (4)
     if ( argc != 4 )
     {
         cout << "Invalid number of command line arguments" << endl;
         return 1;
     }
+    compileFilters();
+    if ( hash )
+        previous.name.clear();
     dirpath = argv[1];
     git = argv[2];
     nonGit = argv[3];
-    gitbool = false;
     //remove backslash if there is one
     if ( dirpath[0] == '\\' )
         dirpath.erase( 0, 1 );
@@ -142,30 +232,64 @@ int main( int argc, char* argv[] )
         return 2;
     }
     //open both xml files
-    gitxml.open( git );
-    nonGitxml.open( nonGit );
     //check if files opened
-    if ( !gitxml || !nonGitxml )
+    if ( !xmlOpen( gitxml, git ) || !xmlOpen( nonGitxml, nonGit ) )
     {
         cout << "Xml files failed to open." << endl;
         return 3;
     }
-    //change directory and check if it worked
-    if ( _chdir( dirpath.c_str() ) != 0 )
+    //open the folder and check if it worked
+    if ( !openRoot( *root, dirpath ) )
     {
-        cout << "Unable to change to the directory: " << argv[1] << endl;
+        cout << "Unable to open the directory: " << argv[1] << endl;
         return 4;
     }
     //output required lines to both files
-    gitxml << "<?xml version=\"1.0\"?>\n<folders>" << endl;
-    nonGitxml << "<?xml version=\"1.0\"?>\n<folders>" << endl;
-    //process files recursively
-    processFiles( gitxml, nonGitxml, gitbool );
+    gitxml.buffer += "<?xml version=\"1.0\"?>\n<folders>\n";
+    nonGitxml.buffer += "<?xml version=\"1.0\"?>\n<folders>\n";
+    //process every folder, then write them out in order
+    tree.path = root->path;
+    tree.dir = root;
+    tree.opened = true;
+    tree.depth = 1;
+    root.reset();
+    if ( interval > 0 && !startWatch() )
+    {
+        cout << "Unable to watch the folders." << endl;
+        return 5;
+    }
+    //after the watch can fail, so no hashing threads are left running
+    if ( hash )
+        startHashing( threads );
+    if ( previous.name.size() != 0 )
+        loadSnapshot( previous );
+    previous.startedAt = clockNow();
+    walkTree( tree, threads, previous.name.size() != 0 ? &previous : nullptr );
+    if ( hash && interval == 0 )
+        finishHashing();
+    waitHashing();
+    if ( previous.name.size() != 0 )
+    {
+        closeSnapshot( previous );
+        if ( !saveSnapshot( tree, previous ) )
+            cout << "Unable to save the snapshot: " << previous.name << endl;
+    }
+    writeFolders( tree, gitxml, nonGitxml, interval > 0 );
     //output folders closing tag and close files
-    gitxml << "</folders>" << endl;
-    nonGitxml << "</folders>" << endl;
-    gitxml.close();
-    nonGitxml.close();
+    gitxml.buffer += "</folders>\n";
+    nonGitxml.buffer += "</folders>\n";
+    if ( !xmlClose( gitxml ) || !xmlClose( nonGitxml ) )
+    {
+        cout << "Xml files failed to write." << endl;
+        return 3;
+    }
+    if ( interval > 0 && !watchTree( tree, git, nonGit, threads, interval ) )
+    {
+        cout << "Unable to watch the folders." << endl;
+        if ( hash )
+            finishHashing();
+        return 5;
+    }
     return 0;
 }
 
@@ -173,80 +297,113 @@ int main( int argc, char* argv[] )
  * @author Dillon Roller
  * 
  * @par Description: 
- * Handles the outputting of folders and appropriate files to the correct
- * xml files. If the folder is under git control, all folders and files 
- * contained in this folder will be outputted to gitxml, otherwise it goes to
- * the Non-Git xml file. If a folder is encountered, this functions makes a 
- * recursive call to itself and processes that folder, until there are no more
- * folders to process, in which case it drops out and moves onto the next 
- * folder in the outer directory, and so on. 
- * 
- * @param[in]   gitxml - file containing all folders/files under git control
- * @param[in]   nonGitxml - file containing all folders/files not under
- *                          git control
- * @param[in]   git - bool containing whether or not the current directory 
- *                    being processed is under git control
+ * Handles the outputting of one folder and its appropriate files. The folder
+ * is opened inside its parent and read once, and its files and folders are
+ * both taken from that one listing. If the folder is under git control, it
+ * and all folders and files contained in it will be outputted to gitxml,
+ * otherwise they go to the Non-Git xml file. Its lines are kept in its node
+ * until the whole tree is written out, and a node is made for every folder
+ * inside it, for the walk to process next. When watching, the folder's
+ * watch is added before it is read. The open folder is shared with the
+ * folders inside it while few enough folders are held open, otherwise they
+ * are opened from the folder it was opened from, with the rest of their
+ * path. A folder that turns out to be one of the
+ * folders above it, through a link or a mount, is output empty instead of
+ * being walked again.
+ * 
+ * @param[in,out] node - the folder being processed, its parent's git
+ *                       control already in git
+ * @param[in,out] buffer - space for the listing, reused from folder to folder
+ * @param[in]   previous - snapshot of the last walk, whose record is used
+ *                         instead of reading the folder if it is unchanged,
+ *                         nullptr to always read it
  * 
  * @returns none
  * 
  ****************************************************************************/
-void processFiles( ofstream &gitxml, ofstream &nonGitxml, bool git )
+void processFiles( walkNode &node, entryBuffer &buffer,
+    const snapshot *previous )
 {
     //variables 
-    intptr_t dir_handle;
-    _finddata_t a_file;
-    string filename;
-    char *directory;
+    size_t first, last, k;
+    shared_ptr<folder> dir, shared, above;
+    walkNode *inner;
+    bool stamped;
+    //open the folder, then the one above can be closed once the others are
+    dir = node.dir;
+    above.swap( node.parent );
+    if ( dir == nullptr )
+    {
+        dir.reset( new folder, deleteFolder );
+        if ( above != nullptr )
+            node.opened = openFolder( *dir, *above, node.path );
+        else
+            node.opened = openPath( *dir, node.path );
+        if ( !node.opened )
+            return;
+    }
+    node.dir.reset();
+    //the folders inside it open from it if it can be held, otherwise from
+    //the folder it was opened from
+    shared = canHoldFolder( *dir, above.get() ) ? dir : above;
+    above.reset();
+    stamped = stampFolder( *dir, node.stamp );
+    if ( stamped && isLoop( node ) )
+    {
+        node.loop = true;
+        node.listed = true;
+        outputFolder( node.lines, node.path, node.depth );
+        return;
+    }
+    watchFolder( node );
+    if ( previous != nullptr && stamped &&
+        reuseFolder( node, shared, *previous ) )
+        return;
+    //read the folder once
+    first = buffer.used;
+    node.listed = readFolder( *dir, buffer );
+    last = buffer.used;
     //check if its git if it's not already git
-    if ( !git )
-        git = isGit();
-    
-    //dynamically allocate cstring containing directory path name
-    directory = _getcwd( NULL, 0 );
+    node.hasGit = isGit( buffer.entries.data() + first, last - first );
+    if ( !node.git && node.hasGit )
+    {
+        node.git = true;
+        //its parent is not in gitxml, so it starts at the top there
+        node.depth = 1;
+    }
+    //a repository of its own, even inside another one
+    if ( node.hasGit )
+        openIndex( node );
     
-    outputFolder( gitxml, nonGitxml, git, directory );
+    outputFolder( node.lines, node.path, node.depth );
 
     //output vs files to appropriate xml file
-    dir_handle = _findfirst( "*.*", &a_file );
-    if( dir_handle == -1 ) 
-        return;
-    do
-    {
-        if ( !( a_file.attrib & _A_SUBDIR ) )
-        {
-            filename = ( string )a_file.name;
-            outputFiles( filename, git, gitxml, nonGitxml );
-        }
-    } while( _findnext( dir_handle, &a_file ) == 0 );
-    _findclose( dir_handle );
+    for ( k = first; k < last && node.listed; k++ )
+        if ( !buffer.entries[k].isFolder )
+            outputFiles( buffer.entries[k].name, node );
+    if ( !node.files.empty() )
+        queueHashes( node );
 
-    //go through all directories
-    dir_handle = _findfirst( "*.*", &a_file );
-    do
+    //make a node for every directory
+    for ( k = first; k < last && node.listed; k++ )
     {
-        filename = ( string )a_file.name;
-        if ( isValidFolder( filename, a_file ) )
+        if ( isValidFolder( buffer.entries[k] ) )
         {
-            //change directory and process this directory
-            if ( _chdir( filename.c_str() ) != 0 )
-            {
-                cout << "Error processing: " << directory 
-                    << ". Skipping this directory" << endl;
-                delete[] directory;
-                return;
-            }
-            processFiles( gitxml, nonGitxml, git );
-            //change directory back after processing inner directory
-            _chdir( ".." );
+            inner = new walkNode;
+            inner->name = buffer.entries[k].name;
+            inner->path = joinPath( node.path, inner->name );
+            inner->up = &node;
+            inner->listedInode = buffer.entries[k].inode;
+            inner->parent = shared;
+            inner->git = node.git;
+            inner->depth = node.depth + 1;
+            inner->index = node.index;
+            inner->indexPrefix = indexFolder( node, inner->name );
+            node.children.push_back( unique_ptr<walkNode>( inner ) );
         }
-        
-    } while( _findnext( dir_handle, &a_file ) == 0 );
-
-    outputClosingTag( gitxml, nonGitxml, git );
-
-    _findclose( dir_handle );
+    }
 
-    delete[] directory; //delete allocated memory
+    buffer.used = first; //done with this folder's entries
     return;
 }
 
@@ -254,26 +411,23 @@ void processFiles( ofstream &gitxml, ofstream &nonGitxml, bool git )
  * @author Dillon Roller
  * 
  * @par Description: 
- * Checks if the current directory is under git control. A folder is considered 
- * to be under git control if it contains the folder ".git" inside of it, or if
- * it is a folder inside a folder that contains ".git". 
+ * Checks if a directory is under git control from its listing. A folder is
+ * considered to be under git control if it contains the folder ".git" inside
+ * of it, or if it is a folder inside a folder that contains ".git". 
+ *
+ * @param[in]   entries - the listing of the folder to check
+ * @param[in]   count - number of entries in the listing
  *
  * @returns git - true if it is under git, false if not
  * 
  ****************************************************************************/
-bool isGit()
+bool isGit( const folderEntry *entries, size_t count )
 {
-    intptr_t dir_handle;
-    _finddata_t a_file;
-    bool git;
-
-    dir_handle = _findfirst( ".git", &a_file );
-    if ( dir_handle == -1 || !( a_file.attrib & _A_SUBDIR ) )
-        git = false;
-    else
-        git = true;
-    _findclose( dir_handle );
-    return git;
+    size_t k;
+    for ( k = 0; k < count; k++ )
+        if ( entries[k].isFolder && entries[k].name == ".git" )
+            return true;
+    return false;
 }
 
 /*************************************************************************//**
@@ -281,22 +435,22 @@ bool isGit()
  * 
  * @par Description: 
  * Checks if the folder/file is a valid folder to be processed. Folders to not 
- * be processed are: .git, .vs, x64, Debug, the self reference folder '.' and
- * a reference to the previous directory '..'
+ * be processed are the ones matching the skip patterns, by default .git,
+ * .vs, x64 and Debug, the self reference folder '.' and a reference to the
+ * previous directory '..'
  * 
- * @param[in]   filename - string containing name of the file
- * @param[in]   a_file - file handle containing information about file
+ * @param[in]   entry - name of the file and whether it is a folder
  * 
  * @returns true - folder is valid
  * @returns false - folder/file is not valid
  * 
  ****************************************************************************/
-bool isValidFolder( string filename, _finddata_t a_file )
+bool isValidFolder( const folderEntry &entry )
 {
-    if ( a_file.attrib & _A_SUBDIR ) //checks if it a folder
+    const string &filename = entry.name;
+    if ( entry.isFolder ) //checks if it a folder
     {
-        if ( filename != ".git" && filename != ".vs" && filename != "x64" &&
-            filename != "Debug" && filename != "." && filename != ".." )
+        if ( filename != "." && filename != ".." && !matchSkip( filename ) )
         {
             return true;
         }
@@ -308,95 +462,127 @@ bool isValidFolder( string filename, _finddata_t a_file )
  * @author Dillon Roller
  * 
  * @par Description: 
- * Goes through current directory and outputs files with appropriate extension
- * to correct xml file. These extensions are: .sln, .cpp, .vcxproj, .h, and 
- * two files that are named exactly ".gitignore" and ".gitattribute".
+ * Gets a hash of the rules isValidFolder and outputFiles follow, and of
+ * whether links are walked, so a snapshot made under other rules is not
+ * used.
+ * 
+ * @returns the hash of the rules
+ * 
+ ****************************************************************************/
+unsigned long long filterSignature()
+{
+    return hashText( filterRules() + ( followingLinks() ? " follow" : "" ) );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ * 
+ * @par Description: 
+ * Checks if a file is one to be output, that is if it matches the file
+ * patterns. By default it has to have one of these extensions: .sln, .cpp,
+ * .vcxproj, .h, or be one of two files that are named exactly ".gitignore"
+ * and ".gitattribute".
+ * 
+ * @param[in]   filename - string containing name of file
+ * 
+ * @returns true - file is output
+ * @returns false - file is left out
+ * 
+ ****************************************************************************/
+bool isValidFile( const string &filename )
+{
+    return matchFile( filename );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ * 
+ * @par Description: 
+ * Outputs a file of the folder being processed if it is one to be output.
+ * Special xml characters in the name are written as entities. A file in a
+ * git repository also gets whether the repository tracks it. When files
+ * are hashed, the file is kept in the folder to be output once it has been.
  * 
  * @param[in]   filename - string containing name of file
- * @param[in]   git - bool containing whether or not directory is under git
- *                    control
- * @param[in]   gitxml - file containing names of files and folders under git
- *                       control
- * @param[in]   nonGitxml - file containing names of files and folders under
- *                          git control
+ * @param[in,out] node - the folder the file is in, whose text it is added to
  * 
  * @returns none
  * 
  ****************************************************************************/
-void outputFiles( string filename, bool git, ofstream &gitxml, ofstream &nonGitxml )
+void outputFiles( const string &filename, walkNode &node )
 {
-    int pos;
-    bool valid = false;
-    string before;
-    string after;
-    //output files with these extension and name only
-    if ( filename.size() > 4 && ( filename.substr( filename.size() - 4 ) 
-        == ".sln" || filename.substr( filename.size() - 4 ) == ".cpp" ) )
-        valid = true;
-    if ( filename.size() > 8 && filename.substr( filename.size() - 8 )
-        == ".vcxproj" )
-        valid = true;
-    if ( filename.size() > 2 && filename.substr( filename.size() - 2 ) == ".h" 
-        )
-        valid = true;
-    if ( filename == ".gitignore" || filename == ".gitattributes" )
-        valid = true;
+    int status = -1;
 
-    if ( valid )
+    if ( !isValidFile( filename ) )
+        return;
+    if ( node.index != nullptr )
+        status = isTracked( node, filename ) ? 1 : 0;
+    if ( hashingFiles() )
     {
-        //replaces all & symbols in file name with "amp;"
-        pos = 0;
-        while ( ( pos = filename.find( "&", pos ) ) != string::npos )
-        {
-            before = filename.substr( 0, pos );
-            after = filename.substr( pos + 1 );
-            before += "&amp;" + after;
-            pos += 5;
-            filename = before;
-        }
-        //replaces all ' symbols in file name with "&apos;"
-        pos = 0;
-        while ( ( pos = filename.find( "'", pos ) ) != string::npos )
-        {
-            before = filename.substr( 0, pos ); 
-            after = filename.substr( pos + 1 ); 
-            before += "&apos;" + after; 
-            pos += 6;
-            filename = before;
-        }
-        //outputs files with appropriate attribute name
-        if( git )
-            gitxml << "<file name=\"" << filename << "\"/>" << endl;
-        else
-            nonGitxml << "<file name=\"" << filename << "\"/>" << endl;
+        node.files.push_back( hashedFile() );
+        node.files.back().name = filename;
+        node.files.back().status = status;
+        return;
     }
+    outputFile( node.lines, node.depth, filename, status, -1, nullptr );
 }
 
 /*************************************************************************//**
  * @author Dillon Roller
  * 
  * @par Description: 
- * Outputs folder name to correct xml file, depending on if it is git or not, 
- * before it is processed.
- * 
- * @param[in]   gitxml - file that contains folder/file names that are under 
- *                       git control
- * @param[in]   nonGitxml - file that contains folder/file names that are not
- *                          under git control
- * @param[in]   git - bool that contains whether or not the current directory
- *                    is under git
- * @param[in]   directory - pointer to cstyle array containing the name of 
- *                          the folder that is about to be processed
+ * Outputs the line of one file. Special xml characters in the name are
+ * written as entities.
+ * 
+ * @param[in,out] lines - text of the folder the file is added to
+ * @param[in]   depth - level of the folder the file is in
+ * @param[in]   filename - string containing name of file
+ * @param[in]   status - 1 tracked, 0 untracked, -1 not in a repository
+ * @param[in]   size - bytes in the file, -1 to leave out its size and hash
+ * @param[in]   sha1 - its git blob SHA-1 in hex, if size is given
+ * 
  * @returns none
  * 
  ****************************************************************************/
-void outputFolder( ofstream &gitxml, ofstream &nonGitxml, bool git, 
-    char *directory )
+void outputFile( string &lines, int depth, const string &filename,
+    int status, long long size, const char *sha1 )
 {
-    if ( git )
-        gitxml << "<folder name=\"" << directory << "\">" << endl;
-    else
-        nonGitxml << "<folder name=\"" << directory << "\">" << endl;
+    xmlIndent( lines, depth + 1 );
+    lines += "<file name=\"";
+    xmlEscape( lines, filename );
+    if ( status >= 0 )
+        lines += status == 1 ? "\" status=\"tracked" : "\" status=\"untracked";
+    if ( size >= 0 )
+    {
+        lines += "\" size=\"";
+        lines += to_string( size );
+        lines += "\" sha1=\"";
+        lines += sha1;
+    }
+    lines += "\"/>\n";
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ * 
+ * @par Description: 
+ * Outputs the opening tag of a folder before it is processed. Special xml
+ * characters in the path are written as entities.
+ * 
+ * @param[in,out] lines - text of the folder the tag is added to
+ * @param[in]   directory - full path of the folder that is about to be
+ *                          processed
+ * @param[in]   depth - level of the folder
+ *
+ * @returns none
+ * 
+ ****************************************************************************/
+void outputFolder( string &lines, const string &directory, int depth )
+{
+    xmlIndent( lines, depth );
+    lines += "<folder name=\"";
+    xmlEscape( lines, directory );
+    lines += "\">\n";
 }
 
 /*************************************************************************//**
@@ -405,21 +591,15 @@ void outputFolder( ofstream &gitxml, ofstream &nonGitxml, bool git,
  * @par Description: 
  * Outputs closing tag after each folder is finished processing
  * 
- * @param[in]   gitxml - file that contains folder/file names that are under 
- *                       git control
- * @param[in]   nonGitxml - file that contains folder/file names that are not
- *                          under git control
- * @param[in]   git - bool that contains whether or not the current directory
- *                    is under git
+ * @param[in,out] xml - the xml file the folder was written to
+ * @param[in]   depth - level of the folder
  * 
  * @returns none
  * 
  ****************************************************************************/
-void outputClosingTag( ofstream &gitxml, ofstream &nonGitxml, bool git )
+void outputClosingTag( xmlWriter &xml, int depth )
 {
-    if( git )
-        gitxml << "</folder>" << endl;
-    else 
-        nonGitxml << "</folder>" << endl;
+    xmlIndent( xml.buffer, depth );
+    xml.buffer += "</folder>\n";
+    xmlSpill( xml );
 }
-
@@ -0,0 +1,281 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Types and prototypes shared by the files of Git My Folders
+ ****************************************************************************/
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+using namespace std;
+
+#ifndef __PROG3__H__
+#define __PROG3__H__
+
+/*!
+ * @brief Bytes of xml held before they are written to the file
+ */
+const size_t XML_BUFFER_SIZE = 1 << 20;
+
+/*!
+ * @brief A folder that is open for listing
+ */
+struct folder
+{
+    string path;                /*!< Full path of the folder, as output*/
+#ifndef _WIN32
+    DIR *list = nullptr;        /*!< Open listing, also holds the descriptor*/
+#endif
+};
+
+/*!
+ * @brief One entry of a folder listing
+ */
+struct folderEntry
+{
+    string name;                /*!< Name of the entry inside its folder*/
+    bool isFolder;              /*!< Entry is a folder, not a file or link*/
+    unsigned long long inode;   /*!< Inode the listing gave, 0 if none*/
+};
+
+/*!
+ * @brief Listings of the folders being walked, one after another
+ */
+struct entryBuffer
+{
+    vector<folderEntry> entries; /*!< Entries, spares keep their names' space*/
+    size_t used = 0;             /*!< Entries in use, the rest are spare*/
+};
+
+/*!
+ * @brief What a folder's own entry on disk looked like when it was read
+ */
+struct folderStamp
+{
+    unsigned long long device = 0;  /*!< Device the folder is on*/
+    unsigned long long inode = 0;   /*!< Its inode, 0 where there are none*/
+    long long modified = 0;         /*!< Last change to its entries, in ns*/
+    long long changed = 0;          /*!< Last change to it at all, in ns*/
+};
+
+/*!
+ * @brief The snapshot file of the last walk, mapped into memory
+ */
+struct snapshot
+{
+    string name;                /*!< File the snapshot is kept in*/
+    const char *data = nullptr; /*!< The mapped file, nullptr if none*/
+    size_t size = 0;            /*!< Bytes mapped*/
+    size_t count = 0;           /*!< Folders in its index*/
+    long long takenAt = 0;      /*!< When the last walk started, in ns*/
+    long long startedAt = 0;    /*!< When this walk started, in ns*/
+    void *mapping = nullptr;    /*!< Handle of the mapping on Windows*/
+};
+
+/*!
+ * @brief The paths tracked by a git repository, from its index
+ */
+struct gitIndex
+{
+    unordered_set<unsigned long long> paths; /*!< Hashes of tracked paths*/
+    unsigned long long stamp = 1;   /*!< Size, inode and times of the file*/
+    long long modified = 0;         /*!< Last change to the file, in ns*/
+};
+
+/*!
+ * @brief An output file, waiting for its hash when files are hashed
+ */
+struct hashedFile
+{
+    string name;                /*!< Name of the file inside its folder*/
+    int status = -1;            /*!< 1 tracked, 0 untracked, -1 no repository*/
+    long long size = -1;        /*!< Bytes in it, -1 if it could not be read*/
+    char sha1[41];              /*!< Its git blob SHA-1 in hex*/
+};
+
+/*!
+ * @brief A SHA-1 hash that bytes are being added to
+ */
+struct sha1State
+{
+    unsigned h[5];              /*!< The hash so far*/
+    unsigned char block[64];    /*!< Bytes of a block not yet hashed*/
+    size_t used;                /*!< Bytes in block*/
+    unsigned long long length;  /*!< Bytes added in all*/
+};
+
+/*!
+ * @brief One character of a trie of reversed names
+ */
+struct trieNode
+{
+    char letter = 0;            /*!< Character this node adds*/
+    int child = -1;             /*!< First node after it, -1 if none*/
+    int sibling = -1;           /*!< Next node with the same parent*/
+    bool exact = false;         /*!< A whole name ends here*/
+    bool suffix = false;        /*!< A suffix ends here, more has to come*/
+};
+
+/*!
+ * @brief A list of name patterns compiled for matching
+ */
+struct nameFilter
+{
+    vector<trieNode> trie;      /*!< Names and suffixes, node 0 is the root*/
+    vector<string> globs;       /*!< Patterns matched as globs*/
+    vector<string> patterns;    /*!< Every pattern, as given*/
+};
+
+/*!
+ * @brief One folder of the walk and what was found in it
+ */
+struct walkNode
+{
+    walkNode() = default;
+    walkNode( walkNode && ) = default;
+    walkNode &operator=( walkNode && ) = default;
+    ~walkNode();
+
+    string name;                /*!< Name of the folder inside its parent*/
+    string path;                /*!< Full path of the folder, as output*/
+    const walkNode *up = nullptr; /*!< Folder it is in, nullptr at the top*/
+    unsigned long long listedInode = 0; /*!< Inode its parent listed*/
+    shared_ptr<folder> parent;  /*!< Open folder above to open it from*/
+    shared_ptr<folder> dir;     /*!< The folder if it is already open*/
+    bool hasGit = false;        /*!< Folder has a .git folder in it*/
+    bool git = false;           /*!< Folder is under git control*/
+    int depth = 1;              /*!< Level in its xml file, the top is 1*/
+    bool opened = false;        /*!< Folder could be opened*/
+    bool listed = false;        /*!< Folder could be listed*/
+    bool loop = false;          /*!< Folder is also a folder above it*/
+    string lines;               /*!< Its folder line and file lines*/
+    vector<hashedFile> files;   /*!< Its files while they are being hashed*/
+    folderStamp stamp;          /*!< Its entry on disk when it was read*/
+    shared_ptr<gitIndex> index; /*!< Index of its repository, if readable*/
+    unsigned long long indexPrefix = 0; /*!< Hash of its path in there*/
+    int watch = -1;             /*!< Its inotify watch, -1 if it has none*/
+    int gitWatch = -1;          /*!< Watch of its .git folder, -1 if none*/
+    bool dirty = false;         /*!< Changed since it was read, when watching*/
+    vector<unique_ptr<walkNode>> children; /*!< Folders to process inside*/
+};
+
+/*!
+ * @brief An xml file and the text waiting to be written to it
+ */
+struct xmlWriter
+{
+    ofstream file;              /*!< The xml file*/
+    string buffer;              /*!< Text not yet written to the file*/
+};
+
+//benchmark.cpp
+bool generateTree( const string &shape, const string &path );
+bool runBenchmarks( const string &outname );
+
+//hashFiles.cpp
+void startHashing( int threads );
+bool hashingFiles();
+void queueHashes( walkNode &node );
+void waitHashing();
+void finishHashing();
+void outputHashedFiles( walkNode &node );
+
+//filters.cpp
+bool addFilter( const string &kind, const string &pattern );
+bool readFilters( const string &name );
+void compileFilters();
+string filterRules();
+bool matchFile( const string &name );
+bool matchSkip( const string &name );
+
+//gitIndex.cpp
+bool stampIndex( const string &repository, unsigned long long &stamp,
+    long long &modified );
+shared_ptr<gitIndex> loadIndex( const string &repository );
+void openIndex( walkNode &node );
+unsigned long long indexFolder( const walkNode &node, const string &name );
+bool isTracked( const walkNode &node, const string &name );
+
+//folders.cpp
+string joinPath( const string &path, const string &name );
+bool openRoot( folder &dir, const string &path );
+void setFollowLinks( bool follow );
+bool followingLinks();
+bool openFolder( folder &dir, const folder &above, const string &path );
+bool openPath( folder &dir, const string &path );
+bool canHoldFolder( const folder &dir, const folder *above );
+int takeFolderPeak();
+void addEntry( entryBuffer &buffer, const char *name, bool isFolder,
+    unsigned long long inode );
+bool readFolder( folder &dir, entryBuffer &buffer );
+void closeFolder( folder &dir );
+
+//walk.cpp
+void deleteFolder( folder *dir );
+bool isLoop( const walkNode &node );
+void walkTree( walkNode &root, int threads, const snapshot *previous );
+void writeFolders( walkNode &node, xmlWriter &gitxml, xmlWriter &nonGitxml,
+    bool keep );
+
+//sha1.cpp
+void sha1Start( sha1State &sha );
+void sha1Add( sha1State &sha, const char *data, size_t size );
+void sha1Finish( sha1State &sha, char *hex );
+
+//snapshot.cpp
+long long clockNow();
+unsigned long long hashMore( unsigned long long hash, const char *data,
+    size_t size );
+unsigned long long hashBytes( const char *data, size_t size );
+unsigned long long hashText( const string &text );
+void putNumber( string &out, unsigned long long value, int bytes );
+unsigned long long getNumber( const char *data, int bytes );
+bool stampFolder( folder &dir, folderStamp &stamp );
+bool mapFile( const string &name, const char *&data, size_t &size,
+    void *&mapping );
+void unmapFile( const char *data, size_t size, void *mapping );
+void loadSnapshot( snapshot &snap );
+void closeSnapshot( snapshot &snap );
+bool reuseFolder( walkNode &node, const shared_ptr<folder> &shared,
+    const snapshot &snap );
+bool saveSnapshot( const walkNode &root, const snapshot &snap );
+
+//watch.cpp
+bool startWatch();
+void watchFolder( walkNode &node );
+void watchIndex( walkNode &node );
+bool rewriteXml( walkNode &tree, const string &git, const string &nonGit );
+bool watchTree( walkNode &tree, const string &git, const string &nonGit,
+    int threads, int interval );
+
+//xmlWriter.cpp
+void setXmlIndent( int spaces );
+int getXmlIndent();
+void xmlIndent( string &out, int depth );
+void xmlEscape( string &out, const string &text );
+bool xmlOpen( xmlWriter &xml, const string &name );
+void xmlSpill( xmlWriter &xml );
+bool xmlClose( xmlWriter &xml );
+
+//prog3.cpp
+void processFiles( walkNode &node, entryBuffer &buffer,
+    const snapshot *previous );
+unsigned long long filterSignature();
+bool isGit( const folderEntry *entries, size_t count );
+bool isValidFolder( const folderEntry &entry );
+bool isValidFile( const string &filename );
+void outputFiles( const string &filename, walkNode &node );
+void outputFile( string &lines, int depth, const string &filename,
+    int status, long long size, const char *sha1 );
+void outputClosingTag( xmlWriter &xml, int depth );
+void outputFolder( string &lines, const string &directory, int depth );
+#endif
@@ -0,0 +1,198 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief SHA-1, the hash git names its objects with
+ *
+ * Bytes are added in pieces of any size and hashed a 64 byte block at a
+ * time, so a file can be hashed straight from where it was read or mapped.
+ ****************************************************************************/
+#include "prog3.h"
+#include <algorithm>
+#include <cstring>
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Rotates a 32 bit word left.
+ *
+ * @param[in]   word - the word
+ * @param[in]   bits - bits to rotate by
+ *
+ * @returns the rotated word
+ *
+ ****************************************************************************/
+static inline unsigned rotateLeft( unsigned word, int bits )
+{
+    return ( word << bits ) | ( word >> ( 32 - bits ) );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Does one round of mixing, moving the five words of the hash along.
+ *
+ * @param[in,out] a - first word
+ * @param[in,out] b - second word
+ * @param[in,out] c - third word
+ * @param[in,out] d - fourth word
+ * @param[in,out] e - fifth word
+ * @param[in]   f - the round's function of b, c and d
+ * @param[in]   k - the round's constant
+ * @param[in]   w - the round's word of the block
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+static inline void sha1Round( unsigned &a, unsigned &b, unsigned &c,
+    unsigned &d, unsigned &e, unsigned f, unsigned k, unsigned w )
+{
+    unsigned next = rotateLeft( a, 5 ) + f + e + k + w;
+
+    e = d;
+    d = c;
+    c = rotateLeft( b, 30 );
+    b = a;
+    a = next;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Mixes one 64 byte block into the hash.
+ *
+ * @param[in,out] sha - the hash so far
+ * @param[in]   block - the block
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+static void sha1Block( sha1State &sha, const unsigned char *block )
+{
+    unsigned w[80], a, b, c, d, e;
+    int i;
+
+    for ( i = 0; i < 16; i++ )
+        w[i] = (unsigned)block[4 * i] << 24 |
+            (unsigned)block[4 * i + 1] << 16 |
+            (unsigned)block[4 * i + 2] << 8 | (unsigned)block[4 * i + 3];
+    for ( i = 16; i < 80; i++ )
+        w[i] = rotateLeft( w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1 );
+    a = sha.h[0];
+    b = sha.h[1];
+    c = sha.h[2];
+    d = sha.h[3];
+    e = sha.h[4];
+    //the four kinds of rounds in their own loops, with no test per round
+    for ( i = 0; i < 20; i++ )
+        sha1Round( a, b, c, d, e, ( ( c ^ d ) & b ) ^ d, 0x5a827999, w[i] );
+    for ( ; i < 40; i++ )
+        sha1Round( a, b, c, d, e, b ^ c ^ d, 0x6ed9eba1, w[i] );
+    for ( ; i < 60; i++ )
+        sha1Round( a, b, c, d, e, ( b & c ) | ( ( b | c ) & d ), 0x8f1bbcdc,
+            w[i] );
+    for ( ; i < 80; i++ )
+        sha1Round( a, b, c, d, e, b ^ c ^ d, 0xca62c1d6, w[i] );
+    sha.h[0] += a;
+    sha.h[1] += b;
+    sha.h[2] += c;
+    sha.h[3] += d;
+    sha.h[4] += e;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Starts a new hash.
+ *
+ * @param[out]  sha - the hash
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void sha1Start( sha1State &sha )
+{
+    sha.h[0] = 0x67452301;
+    sha.h[1] = 0xefcdab89;
+    sha.h[2] = 0x98badcfe;
+    sha.h[3] = 0x10325476;
+    sha.h[4] = 0xc3d2e1f0;
+    sha.used = 0;
+    sha.length = 0;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds bytes to a hash. Whole blocks are hashed where they are, only the
+ * bytes of a partly filled block are copied.
+ *
+ * @param[in,out] sha - the hash
+ * @param[in]   data - the bytes
+ * @param[in]   size - number of bytes
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void sha1Add( sha1State &sha, const char *data, size_t size )
+{
+    const unsigned char *p = (const unsigned char *)data;
+    size_t take;
+
+    sha.length += size;
+    if ( sha.used > 0 )
+    {
+        take = min( size, sizeof( sha.block ) - sha.used );
+        memcpy( sha.block + sha.used, p, take );
+        sha.used += take;
+        p += take;
+        size -= take;
+        if ( sha.used < sizeof( sha.block ) )
+            return;
+        sha1Block( sha, sha.block );
+        sha.used = 0;
+    }
+    for ( ; size >= 64; p += 64, size -= 64 )
+        sha1Block( sha, p );
+    memcpy( sha.block, p, size );
+    sha.used = size;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Finishes a hash and writes it out in hex.
+ *
+ * @param[in,out] sha - the hash, used up
+ * @param[out]  hex - 40 hex digits and a nul
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void sha1Finish( sha1State &sha, char *hex )
+{
+    static const char digits[] = "0123456789abcdef";
+    unsigned long long bits = sha.length * 8;
+    unsigned char tail[8];
+    int i;
+
+    for ( i = 0; i < 8; i++ )
+        tail[i] = (unsigned char)( bits >> ( 56 - 8 * i ) );
+    sha1Add( sha, "\x80", 1 );
+    while ( sha.used != 56 )
+        sha1Add( sha, "", 1 );
+    sha1Add( sha, (const char *)tail, 8 );
+    for ( i = 0; i < 20; i++ )
+    {
+        hex[2 * i] = digits[( sha.h[i / 4] >> ( 24 - 8 * ( i % 4 ) ) >> 4 ) &
+            15];
+        hex[2 * i + 1] = digits[( sha.h[i / 4] >> ( 24 - 8 * ( i % 4 ) ) ) &
+            15];
+    }
+    hex[40] = '\0';
+}
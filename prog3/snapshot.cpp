@@ -0,0 +1,666 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Keeps what each folder held after a walk, so the next walk can skip
+ *        reading the folders that have not changed
+ *
+ * A snapshot file starts with a header, then an index of every folder's
+ * path hash and where its record is, sorted by hash, then the records. A
+ * record holds a hash of the rest of the record, the device, inode and
+ * times of the folder, a stamp of its repository's index, the lines it
+ * rendered and the names of the folders inside it, each with the inode it
+ * was listed with. All numbers are little endian. The file is mapped into
+ * memory, so loading it reads nothing until a folder is looked up.
+ *
+ * A folder's times change whenever an entry is added to it, removed from it
+ * or renamed in it, which is all its lines depend on. A folder whose times
+ * fall within a second of the start of the walk that recorded it could have
+ * changed again in the same tick after it was read, so its record is not
+ * trusted, the same way git treats racy entries in its index. The lines of
+ * a folder in a repository also depend on what its index tracks, so the
+ * index file is held to the same rules.
+ ****************************************************************************/
+#include "prog3.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/*!
+ * @brief Bytes in the header of a snapshot file
+ */
+const size_t SNAPSHOT_HEADER = 40;
+
+/*!
+ * @brief A record of one folder, pointing into the mapped snapshot
+ */
+struct snapshotRecord
+{
+    folderStamp stamp;          /*!< The folder's own entry when it was read*/
+    unsigned long long indexStamp; /*!< Its repository's index, 0 if none*/
+    bool hasGit;                /*!< It had a .git folder in it*/
+    bool git;                   /*!< It was under git control*/
+    int depth;                  /*!< Its level in its xml file*/
+    const char *lines;          /*!< The lines it rendered*/
+    size_t linesSize;           /*!< Bytes in lines*/
+    const char *children;       /*!< Its folders, length, name, inode*/
+    size_t childCount;          /*!< Folders inside it*/
+};
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the time now.
+ *
+ * @returns nanoseconds since 1970
+ *
+ ****************************************************************************/
+long long clockNow()
+{
+    return (long long)chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Goes on hashing with 64 bit FNV-1a, so the hash of text that comes in
+ * pieces is the same as the hash of the pieces joined.
+ *
+ * @param[in]   hash - hash of the text so far
+ * @param[in]   data - the next bytes
+ * @param[in]   size - number of bytes
+ *
+ * @returns the hash with the bytes added
+ *
+ ****************************************************************************/
+unsigned long long hashMore( unsigned long long hash, const char *data,
+    size_t size )
+{
+    size_t k;
+
+    for ( k = 0; k < size; k++ )
+        hash = ( hash ^ (unsigned char)data[k] ) * 0x100000001b3ull;
+    return hash;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Hashes a block of bytes with 64 bit FNV-1a.
+ *
+ * @param[in]   data - the bytes
+ * @param[in]   size - number of bytes
+ *
+ * @returns the hash
+ *
+ ****************************************************************************/
+unsigned long long hashBytes( const char *data, size_t size )
+{
+    return hashMore( 0xcbf29ce484222325ull, data, size );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Hashes a string with 64 bit FNV-1a.
+ *
+ * @param[in]   text - the string
+ *
+ * @returns the hash
+ *
+ ****************************************************************************/
+unsigned long long hashText( const string &text )
+{
+    return hashBytes( text.data(), text.size() );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds a little endian number to the end of a string.
+ *
+ * @param[in,out] out - string to add to
+ * @param[in]   value - the number
+ * @param[in]   bytes - bytes to write it in
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void putNumber( string &out, unsigned long long value, int bytes )
+{
+    int b;
+
+    for ( b = 0; b < bytes; b++ )
+        out += (char)( value >> ( 8 * b ) );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a little endian number.
+ *
+ * @param[in]   data - where the number is
+ * @param[in]   bytes - bytes it is written in
+ *
+ * @returns the number
+ *
+ ****************************************************************************/
+unsigned long long getNumber( const char *data, int bytes )
+{
+    unsigned long long value = 0;
+    int b;
+
+    for ( b = 0; b < bytes; b++ )
+        value |= (unsigned long long)(unsigned char)data[b] << ( 8 * b );
+    return value;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the device, inode and times of an open folder.
+ *
+ * @param[in]   dir - the open folder
+ * @param[out]  stamp - what its entry on disk looks like now
+ *
+ * @returns true - folder looked at
+ * @returns false - folder could not be looked at
+ *
+ ****************************************************************************/
+bool stampFolder( folder &dir, folderStamp &stamp )
+{
+#ifdef _WIN32
+    struct _stat64 info;
+
+    if ( _stat64( dir.path.c_str(), &info ) != 0 )
+        return false;
+    stamp.device = (unsigned long long)info.st_dev;
+    stamp.inode = 0;
+    stamp.modified = (long long)info.st_mtime * 1000000000;
+    stamp.changed = (long long)info.st_ctime * 1000000000;
+#else
+    struct stat info;
+
+    if ( fstat( dirfd( dir.list ), &info ) != 0 )
+        return false;
+    stamp.device = (unsigned long long)info.st_dev;
+    stamp.inode = (unsigned long long)info.st_ino;
+    stamp.modified = (long long)info.st_mtim.tv_sec * 1000000000 +
+        info.st_mtim.tv_nsec;
+    stamp.changed = (long long)info.st_ctim.tv_sec * 1000000000 +
+        info.st_ctim.tv_nsec;
+#endif
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Maps a whole file into memory to be read.
+ *
+ * @param[in]   name - name of the file
+ * @param[out]  data - the mapped file
+ * @param[out]  size - bytes mapped
+ * @param[out]  mapping - handle of the mapping on Windows
+ *
+ * @returns true - file mapped
+ * @returns false - file is missing, empty or could not be mapped
+ *
+ ****************************************************************************/
+bool mapFile( const string &name, const char *&data, size_t &size,
+    void *&mapping )
+{
+#ifdef _WIN32
+    HANDLE file, view;
+    LARGE_INTEGER length;
+
+    file = CreateFileA( name.c_str(), GENERIC_READ, FILE_SHARE_READ |
+        FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( file == INVALID_HANDLE_VALUE )
+        return false;
+    view = NULL;
+    if ( GetFileSizeEx( file, &length ) && length.QuadPart > 0 )
+        view = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    CloseHandle( file );
+    if ( view == NULL )
+        return false;
+    data = (const char *)MapViewOfFile( view, FILE_MAP_READ, 0, 0, 0 );
+    if ( data == nullptr )
+    {
+        CloseHandle( view );
+        return false;
+    }
+    size = (size_t)length.QuadPart;
+    mapping = view;
+#else
+    int fd;
+    struct stat info;
+    void *mapped;
+
+    fd = open( name.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 )
+        return false;
+    if ( fstat( fd, &info ) != 0 || info.st_size <= 0 )
+    {
+        close( fd );
+        return false;
+    }
+    size = (size_t)info.st_size;
+    mapped = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( mapped == MAP_FAILED )
+        return false;
+    data = (const char *)mapped;
+    mapping = nullptr;
+#endif
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Unmaps a file mapped by mapFile.
+ *
+ * @param[in]   data - the mapped file
+ * @param[in]   size - bytes mapped
+ * @param[in]   mapping - handle of the mapping on Windows
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void unmapFile( const char *data, size_t size, void *mapping )
+{
+#ifdef _WIN32
+    UnmapViewOfFile( data );
+    CloseHandle( (HANDLE)mapping );
+#else
+    (void)mapping;
+    munmap( (void *)data, size );
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Maps the snapshot file of the last walk into memory. A missing file, or
+ * one written with other settings or rules, leaves the snapshot empty, and
+ * every folder is read.
+ *
+ * @param[in,out] snap - the snapshot, with the name of its file
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void loadSnapshot( snapshot &snap )
+{
+    const char *data = nullptr;
+    size_t size = 0;
+
+    if ( !mapFile( snap.name, data, size, snap.mapping ) )
+        return;
+    snap.data = data;
+    snap.size = size;
+
+    //only used if it was made the same way this walk will be
+    if ( size < SNAPSHOT_HEADER || memcmp( data, "PRG3SNP3", 8 ) != 0 ||
+        getNumber( data + 16, 8 ) != filterSignature() ||
+        (int)getNumber( data + 24, 4 ) != getXmlIndent() ||
+        getNumber( data + 32, 8 ) > ( size - SNAPSHOT_HEADER ) / 16 )
+    {
+        closeSnapshot( snap );
+        return;
+    }
+    snap.takenAt = (long long)getNumber( data + 8, 8 );
+    snap.count = (size_t)getNumber( data + 32, 8 );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Unmaps a snapshot file. Nothing read from it may be used after this.
+ *
+ * @param[in,out] snap - the snapshot, left empty
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void closeSnapshot( snapshot &snap )
+{
+    if ( snap.data != nullptr )
+        unmapFile( snap.data, snap.size, snap.mapping );
+    snap.data = nullptr;
+    snap.mapping = nullptr;
+    snap.size = 0;
+    snap.count = 0;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads the record of a folder at an offset in the snapshot, checking that
+ * it fits inside the file, is for the right path and matches the hash kept
+ * at its start.
+ *
+ * @param[in]   snap - the snapshot
+ * @param[in]   offset - where the record starts
+ * @param[in]   path - full path of the folder
+ * @param[out]  record - the record
+ *
+ * @returns true - record read
+ * @returns false - record is for another path or is damaged
+ *
+ ****************************************************************************/
+bool readRecord( const snapshot &snap, unsigned long long offset,
+    const string &path, snapshotRecord &record )
+{
+    const char *p, *end = snap.data + snap.size;
+    size_t k, length;
+
+    if ( offset > snap.size || snap.size - offset < 61 )
+        return false;
+    p = snap.data + offset + 8;
+    record.stamp.device = getNumber( p, 8 );
+    record.stamp.inode = getNumber( p + 8, 8 );
+    record.stamp.modified = (long long)getNumber( p + 16, 8 );
+    record.stamp.changed = (long long)getNumber( p + 24, 8 );
+    record.indexStamp = getNumber( p + 32, 8 );
+    record.hasGit = ( p[40] & 1 ) != 0;
+    record.git = ( p[40] & 2 ) != 0;
+    record.depth = (int)getNumber( p + 41, 4 );
+    length = (size_t)getNumber( p + 45, 4 );
+    p += 49;
+    if ( (size_t)( end - p ) < length + 4 ||
+        path.compare( 0, string::npos, p, length ) != 0 )
+        return false;
+    p += length;
+    record.linesSize = (size_t)getNumber( p, 4 );
+    record.lines = p + 4;
+    p += 4;
+    if ( (size_t)( end - p ) < record.linesSize + 4 )
+        return false;
+    p += record.linesSize;
+    record.childCount = (size_t)getNumber( p, 4 );
+    record.children = p + 4;
+    p += 4;
+    for ( k = 0; k < record.childCount; k++ )
+    {
+        if ( end - p < 12 )
+            return false;
+        length = (size_t)getNumber( p, 4 );
+        if ( (size_t)( end - p - 12 ) < length )
+            return false;
+        p += 12 + length;
+    }
+    return hashBytes( snap.data + offset + 8, p - snap.data - offset - 8 ) ==
+        getNumber( snap.data + offset, 8 );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Finds the record of a folder, by a binary search of the index for the
+ * hash of its path.
+ *
+ * @param[in]   snap - the snapshot
+ * @param[in]   path - full path of the folder
+ * @param[out]  record - the record
+ *
+ * @returns true - record found
+ * @returns false - folder was not in the last walk
+ *
+ ****************************************************************************/
+bool findRecord( const snapshot &snap, const string &path,
+    snapshotRecord &record )
+{
+    unsigned long long hash = hashText( path );
+    const char *index = snap.data + SNAPSHOT_HEADER;
+    size_t low = 0, high = snap.count, middle;
+
+    while ( low < high )
+    {
+        middle = low + ( high - low ) / 2;
+        if ( getNumber( index + 16 * middle, 8 ) < hash )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    for ( ; low < snap.count && getNumber( index + 16 * low, 8 ) == hash;
+        low++ )
+        if ( readRecord( snap, getNumber( index + 16 * low + 8, 8 ), path,
+            record ) )
+            return true;
+    return false;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Fills in a folder from its record in the last walk instead of reading it,
+ * if the folder has not changed since. It must have the same device, inode
+ * and times, times old enough to be trusted, be under git control and at
+ * the level it was then, and be in a repository whose index is unchanged,
+ * so the recorded lines are exactly what reading it would give. The folder's
+ * entry on disk has already been looked at, so the new snapshot has its
+ * times either way.
+ *
+ * @param[in,out] node - the folder being processed, with its entry on disk
+ *                       looked at
+ * @param[in]   shared - open folder the folders inside it are opened from,
+ *                       nullptr to open them by path
+ * @param[in]   snap - the snapshot of the last walk
+ *
+ * @returns true - folder filled in from the snapshot
+ * @returns false - folder has to be read
+ *
+ ****************************************************************************/
+bool reuseFolder( walkNode &node, const shared_ptr<folder> &shared,
+    const snapshot &snap )
+{
+    snapshotRecord record;
+    const char *p;
+    size_t k, length;
+    walkNode *inner;
+    bool git;
+    int depth;
+    unsigned long long indexStamp = 0;
+    long long indexModified = 0;
+
+    if ( snap.data == nullptr || !findRecord( snap, node.path, record ) )
+        return false;
+    if ( record.stamp.device != node.stamp.device ||
+        record.stamp.inode != node.stamp.inode ||
+        record.stamp.modified != node.stamp.modified ||
+        record.stamp.changed != node.stamp.changed ||
+        node.stamp.modified >= snap.takenAt - 1000000000 ||
+        node.stamp.changed >= snap.takenAt - 1000000000 )
+        return false;
+    git = node.git || record.hasGit;
+    depth = !node.git && record.hasGit ? 1 : node.depth;
+    if ( git != record.git || depth != record.depth )
+        return false;
+    if ( record.hasGit && !stampIndex( node.path, indexStamp,
+        indexModified ) )
+        return false;
+    if ( !record.hasGit && node.index != nullptr )
+    {
+        indexStamp = node.index->stamp;
+        indexModified = node.index->modified;
+    }
+    if ( indexStamp != record.indexStamp ||
+        indexModified >= snap.takenAt - 1000000000 )
+        return false;
+
+    node.listed = true;
+    node.hasGit = record.hasGit;
+    node.git = git;
+    node.depth = depth;
+    if ( node.hasGit )
+        openIndex( node );
+    node.lines.assign( record.lines, record.linesSize );
+    p = record.children;
+    for ( k = 0; k < record.childCount; k++ )
+    {
+        length = (size_t)getNumber( p, 4 );
+        inner = new walkNode;
+        inner->name.assign( p + 4, length );
+        inner->path = joinPath( node.path, inner->name );
+        inner->up = &node;
+        inner->listedInode = getNumber( p + 4 + length, 8 );
+        inner->parent = shared;
+        inner->git = node.git;
+        inner->depth = node.depth + 1;
+        inner->index = node.index;
+        inner->indexPrefix = indexFolder( node, inner->name );
+        node.children.push_back( unique_ptr<walkNode>( inner ) );
+        p += 12 + length;
+    }
+    return true;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds the records of a walked folder and every folder below it. A folder
+ * that was one of the folders above it gets no record, so it is checked
+ * again next time.
+ *
+ * @param[in]   root - the walked folder
+ * @param[in,out] body - the records so far
+ * @param[in,out] index - path hash and offset in body of every record
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void addRecords( const walkNode &root, string &body,
+    vector<pair<unsigned long long, unsigned long long>> &index )
+{
+    vector<const walkNode *> stack( 1, &root );
+    const walkNode *node;
+    size_t k, start;
+    unsigned long long check;
+
+    while ( !stack.empty() )
+    {
+        node = stack.back();
+        stack.pop_back();
+        if ( !node->opened || !node->listed || node->loop )
+            continue;
+        index.push_back( make_pair( hashText( node->path ),
+            (unsigned long long)body.size() ) );
+        start = body.size();
+        putNumber( body, 0, 8 ); //hash of the rest, filled in below
+        putNumber( body, node->stamp.device, 8 );
+        putNumber( body, node->stamp.inode, 8 );
+        putNumber( body, (unsigned long long)node->stamp.modified, 8 );
+        putNumber( body, (unsigned long long)node->stamp.changed, 8 );
+        putNumber( body, node->index != nullptr ? node->index->stamp : 0, 8 );
+        body += (char)( ( node->hasGit ? 1 : 0 ) | ( node->git ? 2 : 0 ) );
+        putNumber( body, node->depth, 4 );
+        putNumber( body, node->path.size(), 4 );
+        body += node->path;
+        putNumber( body, node->lines.size(), 4 );
+        body += node->lines;
+        putNumber( body, node->children.size(), 4 );
+        for ( k = 0; k < node->children.size(); k++ )
+        {
+            putNumber( body, node->children[k]->name.size(), 4 );
+            body += node->children[k]->name;
+            putNumber( body, node->children[k]->listedInode, 8 );
+            stack.push_back( node->children[k].get() );
+        }
+        check = hashBytes( body.data() + start + 8, body.size() - start - 8 );
+        for ( k = 0; k < 8; k++ )
+            body[start + k] = (char)( check >> ( 8 * k ) );
+    }
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes the snapshot of a finished walk, for the next walk to use. It is
+ * written to a temporary file and renamed over the old one, so a walk that
+ * stops part way never leaves half a snapshot.
+ *
+ * @param[in]   root - the walked tree
+ * @param[in]   snap - the snapshot of the last walk, already closed, with
+ *                     the name of the file and when this walk started
+ *
+ * @returns true - snapshot written
+ * @returns false - snapshot could not be written
+ *
+ ****************************************************************************/
+bool saveSnapshot( const walkNode &root, const snapshot &snap )
+{
+    vector<pair<unsigned long long, unsigned long long>> index;
+    string body, header;
+    string temp = snap.name + ".tmp";
+    unsigned long long start;
+    ofstream fout;
+    size_t k;
+
+    addRecords( root, body, index );
+    sort( index.begin(), index.end() );
+    start = SNAPSHOT_HEADER + 16 * index.size();
+
+    header = "PRG3SNP3";
+    putNumber( header, (unsigned long long)snap.startedAt, 8 );
+    putNumber( header, filterSignature(), 8 );
+    putNumber( header, getXmlIndent(), 4 );
+    putNumber( header, 0, 4 );
+    putNumber( header, index.size(), 8 );
+    for ( k = 0; k < index.size(); k++ )
+    {
+        putNumber( header, index[k].first, 8 );
+        putNumber( header, start + index[k].second, 8 );
+    }
+
+    fout.open( temp, ios::out | ios::trunc | ios::binary );
+    if ( !fout )
+        return false;
+    fout.write( header.data(), header.size() );
+    fout.write( body.data(), body.size() );
+    fout.close();
+    if ( fout.fail() )
+    {
+        remove( temp.c_str() );
+        return false;
+    }
+#ifdef _WIN32
+    remove( snap.name.c_str() ); //rename won't replace a file on Windows
+#endif
+    if ( rename( temp.c_str(), snap.name.c_str() ) != 0 )
+    {
+        remove( temp.c_str() );
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,354 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Walks the folder tree on several threads and writes it out in order
+ *
+ * Every folder is a task. A thread lists its folder, writes the folder's
+ * own lines into the folder's node, and queues the folders inside it on its
+ * own queue. Threads take their newest task first, which keeps each thread
+ * walking down one part of the tree, and a thread with nothing left takes
+ * the oldest task of another thread, which is the biggest part of the tree
+ * still waiting. Once every folder is done the nodes are written out in the
+ * same depth first order the walk would have had on one thread.
+ *
+ * Nothing here recurses, so a tree thousands of folders deep needs no more
+ * stack than a flat one: writing out keeps its own stack of folders, and a
+ * node frees the nodes below it one at a time.
+ ****************************************************************************/
+#include "prog3.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/*!
+ * @brief Folders waiting for one thread, that other threads can take
+ */
+struct workQueue
+{
+    mutex lock;                 /*!< Guards tasks*/
+    deque<walkNode *> tasks;    /*!< Owner takes from the back, others front*/
+};
+
+/*!
+ * @brief A folder being written out and the next folder inside it to write
+ */
+struct writeStep
+{
+    walkNode *node;             /*!< The folder*/
+    size_t next;                /*!< Its next folder to write*/
+};
+
+/*!
+ * @brief The queues of all the threads and how much work is left
+ */
+struct walkPool
+{
+    vector<workQueue> queues;   /*!< One queue per thread*/
+    atomic<long long> queued;   /*!< Tasks sitting in the queues*/
+    atomic<long long> left;     /*!< Tasks queued or being worked on*/
+    mutex idleLock;             /*!< Held to sleep or to wake sleepers*/
+    condition_variable wake;    /*!< Signalled when work is queued or done*/
+    const snapshot *previous;   /*!< Last walk's snapshot, nullptr if none*/
+};
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Closes a folder that was shared between nodes and frees it. Used as the
+ * deleter of shared folders, so a folder stays open until the last folder
+ * inside it has been opened.
+ *
+ * @param[in]   dir - the folder to close
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void deleteFolder( folder *dir )
+{
+    closeFolder( *dir );
+    delete dir;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Frees the nodes below a node one at a time, each after its own folders
+ * were taken from it, so freeing a deep tree does not recurse.
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+walkNode::~walkNode()
+{
+    vector<unique_ptr<walkNode>> doomed;
+    unique_ptr<walkNode> last;
+    size_t k;
+
+    doomed.swap( children );
+    while ( !doomed.empty() )
+    {
+        last = move( doomed.back() );
+        doomed.pop_back();
+        for ( k = 0; k < last->children.size(); k++ )
+            doomed.push_back( move( last->children[k] ) );
+        last->children.clear();
+        last.reset();
+    }
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Checks whether an opened folder is one of the folders above it, reached
+ * again through a link or a mount. Only a folder whose inode is not the
+ * one its parent listed, or that is on another device than its parent, can
+ * be, so the folders above are only looked at for those.
+ *
+ * @param[in]   node - the folder, with its entry on disk looked at
+ *
+ * @returns true - folder is a folder above it
+ * @returns false - folder is new to this part of the tree
+ *
+ ****************************************************************************/
+bool isLoop( const walkNode &node )
+{
+    const walkNode *above;
+
+    if ( node.up == nullptr || node.stamp.inode == 0 ||
+        ( node.stamp.inode == node.listedInode &&
+        node.stamp.device == node.up->stamp.device ) )
+        return false;
+    for ( above = node.up; above != nullptr; above = above->up )
+        if ( above->stamp.inode == node.stamp.inode &&
+            above->stamp.device == node.stamp.device )
+            return true;
+    return false;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Queues the folders inside a node on a thread's queue, last one first, so
+ * the thread goes on with the first one like the walk on one thread would.
+ *
+ * @param[in,out] pool - the pool of queues
+ * @param[in]   worker - number of the thread whose queue gets the folders
+ * @param[in]   node - the node whose children are queued
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void queueChildren( walkPool &pool, int worker, walkNode &node )
+{
+    size_t k, count = node.children.size();
+
+    if ( count == 0 )
+        return;
+    pool.left += count;
+    {
+        lock_guard<mutex> guard( pool.queues[worker].lock );
+        for ( k = count; k > 0; k-- )
+            pool.queues[worker].tasks.push_back( node.children[k - 1].get() );
+    }
+    pool.queued += count;
+    //taking the lock makes sure no thread is between checking and sleeping
+    {
+        lock_guard<mutex> guard( pool.idleLock );
+    }
+    if ( count > 1 )
+        pool.wake.notify_all();
+    else
+        pool.wake.notify_one();
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets the next folder for a thread: its own newest one, or else the oldest
+ * one of another thread.
+ *
+ * @param[in,out] pool - the pool of queues
+ * @param[in]   worker - number of the thread looking for work
+ *
+ * @returns the folder, nullptr if every queue was empty
+ *
+ ****************************************************************************/
+walkNode *takeTask( walkPool &pool, int worker )
+{
+    int k, victim, count = (int)pool.queues.size();
+    walkNode *node = nullptr;
+
+    for ( k = 0; k < count && node == nullptr; k++ )
+    {
+        victim = ( worker + k ) % count;
+        lock_guard<mutex> guard( pool.queues[victim].lock );
+        if ( pool.queues[victim].tasks.empty() )
+            continue;
+        if ( k == 0 )
+        {
+            node = pool.queues[victim].tasks.back();
+            pool.queues[victim].tasks.pop_back();
+        }
+        else
+        {
+            node = pool.queues[victim].tasks.front();
+            pool.queues[victim].tasks.pop_front();
+        }
+    }
+    if ( node != nullptr )
+        pool.queued--;
+    return node;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Runs one thread of the walk. It works on folders until every folder of
+ * the tree has been done, sleeping whenever there is nothing to take but
+ * other threads are still working and may queue more.
+ *
+ * @param[in,out] pool - the pool of queues
+ * @param[in]   worker - number of this thread
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void walkWorker( walkPool &pool, int worker )
+{
+    entryBuffer buffer;
+    walkNode *node;
+
+    while ( true )
+    {
+        node = takeTask( pool, worker );
+        if ( node == nullptr )
+        {
+            unique_lock<mutex> idle( pool.idleLock );
+            pool.wake.wait( idle, [&]()
+                { return pool.queued > 0 || pool.left == 0; } );
+            if ( pool.left == 0 )
+                return;
+            continue;
+        }
+        processFiles( *node, buffer, pool.previous );
+        queueChildren( pool, worker, *node );
+        if ( --pool.left == 0 )
+        {
+            lock_guard<mutex> guard( pool.idleLock );
+            pool.wake.notify_all();
+        }
+    }
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Walks the whole tree below an open folder, filling in a node for every
+ * folder.
+ *
+ * @param[in,out] root - node of the open folder to start in
+ * @param[in]   threads - threads to walk with, 0 for one per processor
+ *
+ * @param[in]   previous - snapshot of the last walk to skip unchanged folders
+ *                         with, nullptr to read every folder
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void walkTree( walkNode &root, int threads, const snapshot *previous )
+{
+    walkPool pool;
+    vector<thread> workers;
+    int k;
+
+    if ( threads <= 0 )
+        threads = (int)thread::hardware_concurrency();
+    if ( threads <= 0 )
+        threads = 1;
+    pool.queues = vector<workQueue>( threads );
+    pool.previous = previous;
+    pool.left = 1;
+    pool.queues[0].tasks.push_back( &root );
+    pool.queued = 1;
+
+    for ( k = 1; k < threads; k++ )
+        workers.push_back( thread( walkWorker, ref( pool ), k ) );
+    walkWorker( pool, 0 );
+    for ( k = 0; k < (int)workers.size(); k++ )
+        workers[k].join();
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes a walked folder and everything below it to the xml files, in the
+ * order the walk would have written them on one thread, and frees the nodes
+ * below it as they are written, unless they are kept for watching. A folder
+ * that could not be listed gets no closing tag, and a folder inside it that
+ * could not be opened stops its parent there, also without a closing tag,
+ * just like the walk always has. Files that were hashed get their lines
+ * here, so every hash must be done first.
+ *
+ * @param[in,out] node - the walked folder
+ * @param[in]   gitxml - file containing all folders/files under git control
+ * @param[in]   nonGitxml - file containing all folders/files not under
+ *                          git control
+ * @param[in]   keep - keep the nodes instead of freeing them
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void writeFolders( walkNode &node, xmlWriter &gitxml, xmlWriter &nonGitxml,
+    bool keep )
+{
+    vector<writeStep> stack;
+    walkNode *current = &node;
+
+    while ( current != nullptr || !stack.empty() )
+    {
+        if ( current != nullptr )
+        {
+            xmlWriter &xml = current->git ? gitxml : nonGitxml;
+
+            if ( !current->files.empty() )
+                outputHashedFiles( *current );
+            xml.buffer += current->lines;
+            xmlSpill( xml );
+            if ( current->listed )
+                stack.push_back( { current, 0 } );
+            else if ( !keep && !stack.empty() )
+                stack.back().node->children[stack.back().next - 1].reset();
+            current = nullptr;
+            continue;
+        }
+        writeStep &top = stack.back();
+        if ( top.next < top.node->children.size() &&
+            top.node->children[top.next]->opened )
+        {
+            current = top.node->children[top.next++].get();
+            continue;
+        }
+        if ( top.next < top.node->children.size() )
+            cout << "Error processing: " << top.node->path
+                << ". Skipping this directory" << endl;
+        else
+            outputClosingTag( top.node->git ? gitxml : nonGitxml,
+                top.node->depth );
+        if ( !keep )
+            top.node->children.clear();
+        stack.pop_back();
+        //the folder is written, its parent can let go of it
+        if ( !keep && !stack.empty() )
+            stack.back().node->children[stack.back().next - 1].reset();
+    }
+}
@@ -0,0 +1,661 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Keeps the xml files up to date as the folders change
+ *
+ * After the first walk every folder has an inotify watch, added before the
+ * folder is read so nothing done to it after it was read is missed. The
+ * walked tree is kept in memory. Events only mark the folder they happened
+ * in, and only when they could change its lines: a folder coming or going,
+ * or a file the xml lists. Once the events have been quiet for the
+ * interval, the marked folders are read again, folders new to them are
+ * walked, and both xml files are written to temporary files and renamed
+ * over the old ones, so a reader never sees half a file.
+ *
+ * The .git folder of each repository is watched too, for its index being
+ * written, which changes what is tracked in every folder of the repository.
+ *
+ * Folders that could not get a watch, because the system ran out of them,
+ * are checked for changes to their times every few intervals instead. If
+ * the system loses events because its queue overflowed, the whole tree is
+ * walked again.
+ ****************************************************************************/
+#include "prog3.h"
+#include <cstdio>
+
+#ifdef __linux__
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/*!
+ * @brief Events a watched folder reports
+ */
+const unsigned WATCH_EVENTS = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+    IN_MOVED_TO | IN_ATTRIB | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+/*!
+ * @brief Events a watched .git folder reports, added to any it already has
+ */
+const unsigned INDEX_EVENTS = IN_CREATE | IN_DELETE | IN_MOVED_TO |
+    IN_CLOSE_WRITE | IN_ONLYDIR | IN_DONT_FOLLOW | IN_MASK_ADD;
+
+/*!
+ * @brief Intervals a batch can wait for the events to go quiet
+ */
+const int WATCH_MAX_WAIT = 10;
+
+/*!
+ * @brief Intervals between checks of the folders that have no watch
+ */
+const int WATCH_POLL_INTERVALS = 10;
+
+/*!
+ * @brief Bytes of events read at a time
+ */
+const size_t WATCH_BUFFER_SIZE = 64 * 1024;
+
+/*!
+ * @brief The inotify instance, -1 when not watching
+ */
+static int watchFd = -1;
+
+/*!
+ * @brief When watching started, in ns
+ */
+static long long watchStarted = 0;
+
+/*!
+ * @brief Set once the system has run out of watches and it has been said
+ */
+static atomic<bool> watchLimit( false );
+
+/*!
+ * @brief What the watch loop keeps between batches
+ */
+struct watchState
+{
+    unordered_multimap<int, walkNode *> watches; /*!< Folders of each watch*/
+    size_t unwatched = 0;       /*!< Folders without a watch*/
+    entryBuffer buffer;         /*!< Space for listings*/
+    int threads = 0;            /*!< Threads new folders are walked with*/
+    int interval = 0;           /*!< Quiet time that ends a batch, in ms*/
+    bool pending = false;       /*!< Folders are marked for the next batch*/
+    bool overflow = false;      /*!< Events were lost, walk everything*/
+    long long first = 0;        /*!< When its first event came, in ms*/
+    long long last = 0;         /*!< When its last event came, in ms*/
+    bool polling = false;       /*!< Folders without a watch are checked*/
+    long long checkedAt = 0;    /*!< When the last check started, in ns*/
+};
+#endif
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Starts watching, so every folder processed from now on gets a watch.
+ *
+ * @returns true - watching started
+ * @returns false - watching is not possible on this system
+ *
+ ****************************************************************************/
+bool startWatch()
+{
+#ifdef __linux__
+    watchStarted = clockNow();
+    watchFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    return watchFd >= 0;
+#else
+    return false;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds a watch on a folder that is about to be read, if watching has been
+ * started. A folder that cannot get one is checked later from the times
+ * it had when it was opened.
+ *
+ * @param[in,out] node - the folder, with its entry on disk looked at
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void watchFolder( walkNode &node )
+{
+#ifdef __linux__
+    unsigned events = WATCH_EVENTS;
+
+    if ( watchFd < 0 )
+        return;
+    if ( hashingFiles() )
+        events |= IN_CLOSE_WRITE;
+    if ( followingLinks() )
+        events &= ~IN_DONT_FOLLOW;
+    node.watch = inotify_add_watch( watchFd, node.path.c_str(), events );
+    if ( node.watch >= 0 )
+        return;
+    if ( errno == ENOSPC && !watchLimit.exchange( true ) )
+        cout << "Out of inotify watches, folders without one will be "
+            "checked for changes instead" << endl;
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds a watch on the .git folder of a repository, if watching has been
+ * started, to see its index being written. A repository that cannot get
+ * one has its index checked later instead.
+ *
+ * @param[in,out] node - the folder holding .git, with its index loaded
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void watchIndex( walkNode &node )
+{
+#ifdef __linux__
+    if ( watchFd < 0 )
+        return;
+    node.gitWatch = inotify_add_watch( watchFd,
+        joinPath( node.path, ".git" ).c_str(), INDEX_EVENTS );
+#endif
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes both xml files for a walked tree, keeping the tree. Each file is
+ * written under a temporary name and then renamed over the old one.
+ *
+ * @param[in,out] tree - the walked tree
+ * @param[in]   git - name of the file for folders under git control
+ * @param[in]   nonGit - name of the file for the other folders
+ *
+ * @returns true - both files written
+ * @returns false - a file could not be written
+ *
+ ****************************************************************************/
+bool rewriteXml( walkNode &tree, const string &git, const string &nonGit )
+{
+    xmlWriter gitxml, nonGitxml;
+
+    if ( !xmlOpen( gitxml, git + ".tmp" ) ||
+        !xmlOpen( nonGitxml, nonGit + ".tmp" ) )
+        return false;
+    gitxml.buffer += "<?xml version=\"1.0\"?>\n<folders>\n";
+    nonGitxml.buffer += "<?xml version=\"1.0\"?>\n<folders>\n";
+    writeFolders( tree, gitxml, nonGitxml, true );
+    gitxml.buffer += "</folders>\n";
+    nonGitxml.buffer += "</folders>\n";
+    if ( !xmlClose( gitxml ) || !xmlClose( nonGitxml ) )
+        return false;
+    return rename( ( git + ".tmp" ).c_str(), git.c_str() ) == 0 &&
+        rename( ( nonGit + ".tmp" ).c_str(), nonGit.c_str() ) == 0;
+}
+
+#ifdef __linux__
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Points the folders inside a node back at it, after the node was moved
+ * into from another one.
+ *
+ * @param[in,out] node - the node
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void adoptChildren( walkNode &node )
+{
+    size_t k;
+
+    for ( k = 0; k < node.children.size(); k++ )
+        node.children[k]->up = &node;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads a folder of the tree again. The folders still in it keep their
+ * nodes and everything below them, the folders that are new to it are
+ * walked, and the folders gone from it are dropped. A folder only counts
+ * as still in it when both its name and its inode match, so a folder
+ * renamed over another one is walked rather than taking the old one's
+ * lines and watch.
+ *
+ * @param[in,out] node - the folder
+ * @param[in]   parent - the folder it is in, nullptr for the top folder
+ * @param[in,out] state - the watch loop
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void rereadFolder( walkNode &node, const walkNode *parent,
+    watchState &state )
+{
+    walkNode fresh;
+    shared_ptr<folder> dir( new folder, deleteFolder );
+    unordered_map<string, size_t> kept;
+    size_t k;
+
+    fresh.name = node.name;
+    fresh.path = node.path;
+    fresh.up = parent;
+    fresh.listedInode = node.listedInode;
+    if ( parent != nullptr )
+    {
+        fresh.git = parent->git;
+        fresh.depth = parent->depth + 1;
+        fresh.index = parent->index;
+        fresh.indexPrefix = indexFolder( *parent, node.name );
+    }
+    fresh.opened = openPath( *dir, node.path );
+    if ( fresh.opened )
+    {
+        fresh.dir = dir;
+        processFiles( fresh, state.buffer, nullptr );
+    }
+    dir.reset();
+
+    for ( k = 0; k < node.children.size(); k++ )
+        if ( node.children[k]->opened )
+            kept[node.children[k]->name] = k;
+    for ( k = 0; k < fresh.children.size(); k++ )
+    {
+        auto found = kept.find( fresh.children[k]->name );
+        if ( found == kept.end() || node.children[found->second]->
+            listedInode != fresh.children[k]->listedInode )
+            walkTree( *fresh.children[k], state.threads, nullptr );
+        else
+            fresh.children[k] = move( node.children[found->second] );
+    }
+    //its files are hashed in place, so it cannot move before they are done
+    waitHashing();
+    node = move( fresh );
+    adoptChildren( node );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Checks whether a folder without a watch has changed since it was read,
+ * from its times. Times too close to when it was last checked are not
+ * trusted, since it could have changed again in the same tick.
+ *
+ * @param[in]   node - the folder
+ * @param[in]   state - the watch loop
+ *
+ * @returns true - folder has to be read again
+ * @returns false - folder is unchanged
+ *
+ ****************************************************************************/
+bool folderChanged( const walkNode &node, const watchState &state )
+{
+    folder dir;
+    folderStamp stamp;
+    bool looked;
+
+    looked = openPath( dir, node.path ) && stampFolder( dir, stamp );
+    closeFolder( dir );
+    return !looked || stamp.device != node.stamp.device ||
+        stamp.inode != node.stamp.inode ||
+        stamp.modified != node.stamp.modified ||
+        stamp.changed != node.stamp.changed ||
+        stamp.modified >= state.checkedAt - 1000000000 ||
+        stamp.changed >= state.checkedAt - 1000000000;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Checks whether the index of a repository without a watch on its .git
+ * folder has changed since it was loaded.
+ *
+ * @param[in]   node - the folder holding .git
+ * @param[in]   state - the watch loop
+ *
+ * @returns true - index has to be loaded again
+ * @returns false - index is unchanged
+ *
+ ****************************************************************************/
+bool indexChanged( const walkNode &node, const watchState &state )
+{
+    unsigned long long stamp;
+    long long modified;
+
+    return node.index == nullptr ||
+        !stampIndex( node.path, stamp, modified ) ||
+        stamp != node.index->stamp ||
+        modified >= state.checkedAt - 1000000000;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads again every folder of the tree that was marked by an event, that
+ * changed without a watch, or whose git control, level or index changed
+ * because a .git folder above it came, went or was written to. A folder is
+ * read again before the folders inside it are looked at.
+ *
+ * @param[in,out] tree - the walked tree
+ * @param[in,out] state - the watch loop
+ *
+ * @returns true - a folder was read again
+ * @returns false - nothing changed
+ *
+ ****************************************************************************/
+bool syncTree( walkNode &tree, watchState &state )
+{
+    vector<walkNode *> stack( 1, &tree );
+    walkNode *node;
+    const walkNode *parent;
+    bool git, changed = false;
+    int depth;
+    size_t k;
+
+    while ( !stack.empty() )
+    {
+        node = stack.back();
+        stack.pop_back();
+        parent = node->up;
+        git = parent != nullptr && parent->git;
+        depth = parent != nullptr ? parent->depth + 1 : 1;
+        if ( node->dirty || node->git != ( git || node->hasGit ) ||
+            node->depth != ( !git && node->hasGit ? 1 : depth ) ||
+            ( !node->hasGit && node->index !=
+            ( parent != nullptr ? parent->index : nullptr ) ) ||
+            ( state.polling && node->watch < 0 && node->listed &&
+            !node->loop && folderChanged( *node, state ) ) ||
+            ( state.polling && node->hasGit && node->gitWatch < 0 &&
+            indexChanged( *node, state ) ) )
+        {
+            rereadFolder( *node, parent, state );
+            changed = true;
+        }
+        for ( k = node->children.size(); k > 0; k-- )
+            if ( node->children[k - 1]->opened )
+                stack.push_back( node->children[k - 1].get() );
+    }
+    return changed;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Finds the folder of every watch in the tree and counts the folders and
+ * repositories without one. A folder that is also a folder above it needs
+ * none.
+ *
+ * @param[in]   tree - the walked tree
+ * @param[in,out] state - the watch loop
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void mapWatches( walkNode &tree, watchState &state )
+{
+    vector<walkNode *> stack( 1, &tree );
+    walkNode *node;
+    size_t k;
+
+    while ( !stack.empty() )
+    {
+        node = stack.back();
+        stack.pop_back();
+        if ( node->watch >= 0 )
+            state.watches.insert( make_pair( node->watch, node ) );
+        else if ( node->opened && node->listed && !node->loop )
+            state.unwatched++;
+        if ( node->gitWatch >= 0 )
+            state.watches.insert( make_pair( node->gitWatch, node ) );
+        else if ( node->hasGit )
+            state.unwatched++;
+        for ( k = node->children.size(); k > 0; k-- )
+            stack.push_back( node->children[k - 1].get() );
+    }
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Maps the watches of the tree again after it changed, and removes the
+ * watches of folders that are no longer in it.
+ *
+ * @param[in]   tree - the walked tree
+ * @param[in,out] state - the watch loop
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void remapWatches( walkNode &tree, watchState &state )
+{
+    unordered_multimap<int, walkNode *> old;
+
+    old.swap( state.watches );
+    state.unwatched = 0;
+    mapWatches( tree, state );
+    for ( auto &watch : old )
+        if ( state.watches.count( watch.first ) == 0 )
+            inotify_rm_watch( watchFd, watch.first );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Marks the folder an event happened in, if the event could change its
+ * lines: it or a folder inside it changed who can open it, a folder inside
+ * it came or went, a file the xml lists came, went or was written while
+ * files are hashed, or the index of the repository it holds was written.
+ * A folder reached twice, through a link or a mount, shares one watch, so
+ * every folder with the watch is marked.
+ *
+ * @param[in]   event - the event
+ * @param[in]   state - the watch loop
+ *
+ * @returns true - a folder was marked
+ * @returns false - the event changes nothing
+ *
+ ****************************************************************************/
+bool markEvent( const inotify_event &event, const watchState &state )
+{
+    auto found = state.watches.equal_range( event.wd );
+    bool marked = false;
+
+    for ( auto k = found.first; k != found.second; k++ )
+    {
+        if ( k->second->gitWatch == event.wd )
+        {
+            if ( event.len == 0 || strcmp( event.name, "index" ) != 0 )
+                continue;
+        }
+        else if ( event.len == 0 ? !( event.mask & IN_ATTRIB ) :
+            !( event.mask & IN_ISDIR ) && ( ( event.mask & IN_ATTRIB ) ||
+            !isValidFile( event.name ) ) )
+            continue;
+        k->second->dirty = true;
+        marked = true;
+    }
+    return marked;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Walks the whole tree again into the old one, after events were lost.
+ *
+ * @param[in,out] tree - the walked tree
+ * @param[in,out] state - the watch loop
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void rewalkTree( walkNode &tree, watchState &state )
+{
+    walkNode fresh;
+    shared_ptr<folder> root( new folder, deleteFolder );
+
+    fresh.path = tree.path;
+    if ( !openRoot( *root, tree.path ) )
+        return;
+    root->path = tree.path;
+    fresh.dir = root;
+    fresh.opened = true;
+    root.reset();
+    walkTree( fresh, state.threads, nullptr );
+    waitHashing();
+    tree = move( fresh );
+    adoptChildren( tree );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets when the next batch should be applied: once its events have been
+ * quiet for the interval, or have kept coming for too long, or if there is
+ * no batch, when the folders without a watch are to be checked.
+ *
+ * @param[in]   state - the watch loop
+ *
+ * @returns the time in ms, -1 if there is nothing to wait for
+ *
+ ****************************************************************************/
+long long batchDue( const watchState &state )
+{
+    if ( state.pending )
+        return min( state.last + state.interval,
+            state.first + (long long)state.interval * WATCH_MAX_WAIT );
+    if ( state.unwatched > 0 )
+        return state.checkedAt / 1000000 +
+            (long long)state.interval * WATCH_POLL_INTERVALS;
+    return -1;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Reads the events waiting for the watches and marks the folders they
+ * happened in.
+ *
+ * @param[in,out] state - the watch loop
+ *
+ * @returns true - events read
+ * @returns false - the events could not be read
+ *
+ ****************************************************************************/
+bool readEvents( watchState &state )
+{
+    alignas( inotify_event ) char events[WATCH_BUFFER_SIZE];
+    const inotify_event *event;
+    ssize_t size;
+    char *p;
+
+    while ( ( size = read( watchFd, events, sizeof( events ) ) ) > 0 )
+    {
+        for ( p = events; p < events + size;
+            p += sizeof( inotify_event ) + event->len )
+        {
+            event = (const inotify_event *)p;
+            if ( event->mask & IN_Q_OVERFLOW )
+                state.overflow = true;
+            else if ( !markEvent( *event, state ) )
+                continue;
+            state.last = clockNow() / 1000000;
+            if ( !state.pending )
+                state.first = state.last;
+            state.pending = true;
+        }
+    }
+    return size == 0 || errno == EAGAIN || errno == EINTR;
+}
+#endif
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Watches a walked tree and writes the xml files again after every batch of
+ * changes. Runs until the program is stopped or watching fails.
+ *
+ * @param[in,out] tree - the walked tree, every folder with its watch
+ * @param[in]   git - name of the file for folders under git control
+ * @param[in]   nonGit - name of the file for the other folders
+ * @param[in]   threads - threads to walk new folders with, 0 for one per
+ *                        processor
+ * @param[in]   interval - milliseconds the events must be quiet for before
+ *                         the files are written
+ *
+ * @returns false - the events could not be read
+ *
+ ****************************************************************************/
+bool watchTree( walkNode &tree, const string &git, const string &nonGit,
+    int threads, int interval )
+{
+#ifdef __linux__
+    watchState state;
+    pollfd wait;
+    long long now, due, started;
+    bool changed;
+
+    state.threads = threads;
+    state.interval = interval;
+    state.checkedAt = watchStarted;
+    mapWatches( tree, state );
+    wait.fd = watchFd;
+    wait.events = POLLIN;
+    while ( true )
+    {
+        //wait for events until the batch is due
+        due = batchDue( state );
+        now = clockNow() / 1000000;
+        if ( due < 0 || now < due )
+        {
+            if ( poll( &wait, 1, due < 0 ? -1 : (int)( due - now ) ) < 0 &&
+                errno != EINTR )
+                return false;
+            if ( !readEvents( state ) )
+                return false;
+            continue;
+        }
+
+        //read the marked folders again and write the files
+        started = clockNow();
+        state.polling = state.unwatched > 0;
+        changed = state.overflow;
+        if ( state.overflow )
+            rewalkTree( tree, state );
+        else
+            changed = syncTree( tree, state );
+        state.checkedAt = started;
+        state.pending = state.overflow = false;
+        if ( !changed )
+            continue;
+        remapWatches( tree, state );
+        if ( !rewriteXml( tree, git, nonGit ) )
+            cout << "Xml files failed to write." << endl;
+    }
+#else
+    return false;
+#endif
+}
+
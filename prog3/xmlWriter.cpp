@@ -0,0 +1,161 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Builds xml text and writes it to the xml files in large blocks
+ *
+ * Lines are built by appending to strings, with names escaped in a single
+ * pass. The text for a file is kept in its writer until a whole block is
+ * ready, so the file is written a block at a time instead of a line at a
+ * time.
+ ****************************************************************************/
+#include "prog3.h"
+
+/*!
+ * @brief Spaces each level is indented by, 0 for no indenting
+ */
+static int indentSpaces = 0;
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Sets how many spaces each level of the xml is indented by.
+ *
+ * @param[in]   spaces - spaces per level, 0 to write every line flush left
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void setXmlIndent( int spaces )
+{
+    indentSpaces = spaces > 0 ? spaces : 0;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Gets how many spaces each level of the xml is indented by.
+ *
+ * @returns spaces per level, 0 if lines are not indented
+ *
+ ****************************************************************************/
+int getXmlIndent()
+{
+    return indentSpaces;
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds the indenting for a line at the given level. The folders tag is
+ * level 0.
+ *
+ * @param[in,out] out - text the line is being built in
+ * @param[in]   depth - level of the line
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void xmlIndent( string &out, int depth )
+{
+    out.append( (size_t)indentSpaces * depth, ' ' );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Adds text with the five characters xml gives special meaning to written
+ * as entities: & < > " and '. The text is copied in runs between those
+ * characters, so it is only looked at once.
+ *
+ * @param[in,out] out - text to add to
+ * @param[in]   text - text to escape
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void xmlEscape( string &out, const string &text )
+{
+    size_t k, start = 0;
+    const char *entity;
+
+    for ( k = 0; k < text.size(); k++ )
+    {
+        switch ( text[k] )
+        {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '"': entity = "&quot;"; break;
+            case '\'': entity = "&apos;"; break;
+            default: continue;
+        }
+        out.append( text, start, k - start );
+        out += entity;
+        start = k + 1;
+    }
+    out.append( text, start, string::npos );
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Opens an xml file for writing.
+ *
+ * @param[out]  xml - the writer to open
+ * @param[in]   name - name of the xml file
+ *
+ * @returns true - file opened
+ * @returns false - file could not be opened
+ *
+ ****************************************************************************/
+bool xmlOpen( xmlWriter &xml, const string &name )
+{
+    xml.file.open( name );
+    xml.buffer.reserve( XML_BUFFER_SIZE + XML_BUFFER_SIZE / 4 );
+    return !xml.file.fail();
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes the text a writer is holding to its file once there is a whole
+ * block of it. Called after text is added to the buffer.
+ *
+ * @param[in,out] xml - the writer
+ *
+ * @returns none
+ *
+ ****************************************************************************/
+void xmlSpill( xmlWriter &xml )
+{
+    if ( xml.buffer.size() < XML_BUFFER_SIZE )
+        return;
+    xml.file.write( xml.buffer.data(), xml.buffer.size() );
+    xml.buffer.clear();
+}
+
+/*************************************************************************//**
+ * @author Dillon Roller
+ *
+ * @par Description:
+ * Writes whatever text is left and closes the file.
+ *
+ * @param[in,out] xml - the writer
+ *
+ * @returns true - everything was written
+ * @returns false - the file could not be written
+ *
+ ****************************************************************************/
+bool xmlClose( xmlWriter &xml )
+{
+    xml.file.write( xml.buffer.data(), xml.buffer.size() );
+    xml.buffer.clear();
+    xml.file.close();
+    return !xml.file.fail();
+}